@@ -0,0 +1,114 @@
+#include "Arena.h"
+#include <algorithm>
+
+
+Arena::Arena(size_t blockSize)
+    : m_blockSize(blockSize), m_blocks(nullptr), m_cursor(nullptr), m_end(nullptr), m_used(0), m_reserved(0), m_nextFree(nullptr) {}
+
+Arena::~Arena() {
+    while (m_blocks) {
+        Block* next = m_blocks->next;
+        ::operator delete(m_blocks);
+        m_blocks = next;
+    }
+}
+
+void Arena::addBlock(size_t minimum) {
+    size_t size = std::max(m_blockSize, minimum + sizeof(Block) + alignof(std::max_align_t));
+    Block* block = static_cast<Block*>(::operator new(size));
+    block->next = m_blocks;
+    block->size = size;
+    m_blocks = block;
+    m_cursor = reinterpret_cast<char*>(block) + sizeof(Block);
+    m_end = reinterpret_cast<char*>(block) + size;
+    m_reserved += size;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    size_t space = static_cast<size_t>(m_end - m_cursor);
+    void* pointer = m_cursor;
+    if (!m_cursor || !std::align(alignment, bytes, pointer, space)) {
+        addBlock(bytes + alignment);
+        space = static_cast<size_t>(m_end - m_cursor);
+        pointer = m_cursor;
+        std::align(alignment, bytes, pointer, space);
+    }
+    m_cursor = static_cast<char*>(pointer) + bytes;
+    m_used += bytes;
+    return pointer;
+}
+
+void Arena::reset() {
+    if (!m_blocks) {
+        return;
+    }
+    // everything but the oldest block goes back to the heap
+    while (m_blocks->next) {
+        Block* next = m_blocks->next;
+        m_reserved -= m_blocks->size;
+        ::operator delete(m_blocks);
+        m_blocks = next;
+    }
+    m_cursor = reinterpret_cast<char*>(m_blocks) + sizeof(Block);
+    m_end = reinterpret_cast<char*>(m_blocks) + m_blocks->size;
+    m_used = 0;
+}
+
+size_t Arena::bytesUsed() const {
+    return m_used;
+}
+
+size_t Arena::bytesReserved() const {
+    return m_reserved;
+}
+
+ArenaPool::ArenaPool(size_t maxIdle) : m_free(nullptr), m_idle(0), m_maxIdle(maxIdle) {}
+
+ArenaPool::~ArenaPool() {
+    while (m_free) {
+        Arena* next = m_free->m_nextFree;
+        delete m_free;
+        m_free = next;
+    }
+}
+
+ArenaPool& ArenaPool::shared() {
+    static ArenaPool pool;
+    return pool;
+}
+
+ArenaPool::Handle ArenaPool::acquire() {
+    Arena* arena = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free) {
+            arena = m_free;
+            m_free = arena->m_nextFree;
+            m_idle--;
+        }
+    }
+    if (!arena) {
+        arena = new Arena();
+    }
+    arena->m_nextFree = nullptr;
+    return Handle(arena, Release{ this });
+}
+
+void ArenaPool::release(Arena* arena) {
+    arena->reset();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_idle < m_maxIdle) {
+            arena->m_nextFree = m_free;
+            m_free = arena;
+            m_idle++;
+            return;
+        }
+    }
+    delete arena;
+}
+
+size_t ArenaPool::idle() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_idle;
+}
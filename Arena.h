@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <utility>
+
+// Monotonic allocator for everything one game allocates: its pieces, move history and position
+// keys. Allocation bumps a pointer through fixed-size blocks, deallocation does nothing, and the
+// whole game is dropped at once by reset(). Destructors are not run, so only objects that own no
+// memory outside the arena may be created in it; pieces qualify since their one-letter idents fit
+// in std::string's inline buffer. As a memory_resource it also backs std::pmr containers.
+class Arena : public std::pmr::memory_resource {
+public:
+	explicit Arena(size_t blockSize = 8 * 1024);
+	~Arena() override;
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	template <typename T, typename... Args>
+	T* create(Args&&... args) {
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// forgets every allocation, keeping the first block for the next game
+	void reset();
+
+	size_t bytesUsed() const;
+	size_t bytesReserved() const;
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+private:
+	struct Block {
+		Block* next;
+		size_t size;
+	};
+
+	void addBlock(size_t minimum);
+
+	size_t m_blockSize;
+	Block* m_blocks;     // newest first, the first block allocated is last
+	char* m_cursor;
+	char* m_end;
+	size_t m_used;
+	size_t m_reserved;
+	Arena* m_nextFree;   // link in ArenaPool's free list
+
+	friend class ArenaPool;
+};
+
+// Recycles arenas between games so a finished game's blocks go to the next one instead of back
+// to the heap. Idle arenas sit on an intrusive free list; beyond maxIdle they are freed.
+class ArenaPool {
+public:
+	struct Release {
+		ArenaPool* pool;
+		void operator()(Arena* arena) const { pool->release(arena); }
+	};
+	using Handle = std::unique_ptr<Arena, Release>;
+
+	explicit ArenaPool(size_t maxIdle = 1024);
+	~ArenaPool();
+
+	ArenaPool(const ArenaPool&) = delete;
+	ArenaPool& operator=(const ArenaPool&) = delete;
+
+	// the pool every Game draws from
+	static ArenaPool& shared();
+
+	Handle acquire();
+
+	size_t idle() const;
+
+private:
+	void release(Arena* arena);
+
+	mutable std::mutex m_mutex;
+	Arena* m_free;
+	size_t m_idle;
+	size_t m_maxIdle;
+};
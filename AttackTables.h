@@ -0,0 +1,131 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+
+// Squares, bitboards and every attack table the engine reads, all built at compile time so move
+// generation does no setup and no allocation. Squares are indexed row * 8 + col with row 0 on
+// black's side.
+
+using Bitboard = uint64_t;
+
+constexpr int squareOf(int row, int col) { return row * 8 + col; }
+constexpr int rowOf(int sq) { return sq >> 3; }
+constexpr int colOf(int sq) { return sq & 7; }
+constexpr Bitboard squareBB(int sq) { return 1ULL << sq; }
+constexpr int popCount(Bitboard b) { return std::popcount(b); }
+constexpr int lsb(Bitboard b) { return std::countr_zero(b); }
+constexpr int msb(Bitboard b) { return 63 - std::countl_zero(b); }
+constexpr int popLsb(Bitboard& b) {
+	int sq = lsb(b);
+	b &= b - 1;
+	return sq;
+}
+
+// ray directions as (row, col) steps; the first four grow the square index and the last four shrink it
+constexpr int RAY_DIRECTIONS[8][2] = {
+	{ 1, 0}, { 0, 1}, { 1, 1}, { 1, -1},
+	{-1, 0}, { 0, -1}, {-1, -1}, {-1, 1}
+};
+constexpr int ORTHOGONAL_RAYS[4] = { 0, 1, 4, 5 };
+constexpr int DIAGONAL_RAYS[4] = { 2, 3, 6, 7 };
+
+struct AttackTables {
+	Bitboard knight[64];
+	Bitboard king[64];
+	Bitboard pawn[2][64];        // by colour index, white captures towards row 0
+	Bitboard rays[8][64];        // every square from a square to the edge, by direction
+	Bitboard between[64][64];    // squares strictly between two aligned squares, empty otherwise
+	Bitboard line[64][64];       // the whole line through two aligned squares, empty otherwise
+};
+
+template <int N>
+constexpr Bitboard stepAttacks(int sq, const int (&steps)[N][2]) {
+	Bitboard attacks = 0;
+	for (int i = 0; i < N; i++) {
+		int r = rowOf(sq) + steps[i][0];
+		int c = colOf(sq) + steps[i][1];
+		if (r >= 0 && r < 8 && c >= 0 && c < 8) {
+			attacks |= squareBB(squareOf(r, c));
+		}
+	}
+	return attacks;
+}
+
+constexpr AttackTables makeAttackTables() {
+	constexpr int knightSteps[8][2] = { {-2, 1}, {-2, -1}, {2, -1}, {2, 1}, {-1, 2}, {-1, -2}, {1, -2}, {1, 2} };
+	constexpr int kingSteps[8][2] = { {-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1} };
+	constexpr int whitePawnSteps[2][2] = { {-1, -1}, {-1, 1} };
+	constexpr int blackPawnSteps[2][2] = { {1, -1}, {1, 1} };
+
+	AttackTables tables{};
+	for (int sq = 0; sq < 64; sq++) {
+		tables.knight[sq] = stepAttacks(sq, knightSteps);
+		tables.king[sq] = stepAttacks(sq, kingSteps);
+		tables.pawn[0][sq] = stepAttacks(sq, whitePawnSteps);
+		tables.pawn[1][sq] = stepAttacks(sq, blackPawnSteps);
+
+		for (int dir = 0; dir < 8; dir++) {
+			int r = rowOf(sq) + RAY_DIRECTIONS[dir][0];
+			int c = colOf(sq) + RAY_DIRECTIONS[dir][1];
+			while (r >= 0 && r < 8 && c >= 0 && c < 8) {
+				tables.rays[dir][sq] |= squareBB(squareOf(r, c));
+				r += RAY_DIRECTIONS[dir][0];
+				c += RAY_DIRECTIONS[dir][1];
+			}
+		}
+	}
+
+	for (int from = 0; from < 64; from++) {
+		for (int dir = 0; dir < 8; dir++) {
+			// a square on this ray sees everything before it; the opposite ray completes the line
+			Bitboard full = tables.rays[dir][from] | tables.rays[dir ^ 4][from] | squareBB(from);
+			Bitboard ray = tables.rays[dir][from];
+			while (ray) {
+				int to = popLsb(ray);
+				tables.between[from][to] = tables.rays[dir][from] & tables.rays[dir ^ 4][to];
+				tables.line[from][to] = full;
+			}
+		}
+	}
+	return tables;
+}
+
+inline constexpr AttackTables ATTACKS = makeAttackTables();
+
+constexpr Bitboard knightAttacks(int sq) { return ATTACKS.knight[sq]; }
+constexpr Bitboard kingAttacks(int sq) { return ATTACKS.king[sq]; }
+constexpr Bitboard betweenBB(int from, int to) { return ATTACKS.between[from][to]; }
+constexpr Bitboard lineBB(int from, int to) { return ATTACKS.line[from][to]; }
+
+// the ray from sq in direction dir up to and including the first occupied square
+constexpr Bitboard rayAttacks(int dir, int sq, Bitboard occupied) {
+	Bitboard attacks = ATTACKS.rays[dir][sq];
+	Bitboard blockers = attacks & occupied;
+	if (blockers) {
+		// the nearest blocker is the lowest square on growing rays and the highest on shrinking ones
+		int blocker = dir < 4 ? lsb(blockers) : msb(blockers);
+		attacks ^= ATTACKS.rays[dir][blocker];
+	}
+	return attacks;
+}
+
+// squares along a ray nearest first, for walking a ray until something is found
+constexpr int nearestOnRay(int dir, Bitboard ray) {
+	return dir < 4 ? lsb(ray) : msb(ray);
+}
+
+constexpr Bitboard bishopAttacks(int sq, Bitboard occupied) {
+	return rayAttacks(2, sq, occupied) | rayAttacks(3, sq, occupied) | rayAttacks(6, sq, occupied) | rayAttacks(7, sq, occupied);
+}
+
+constexpr Bitboard rookAttacks(int sq, Bitboard occupied) {
+	return rayAttacks(0, sq, occupied) | rayAttacks(1, sq, occupied) | rayAttacks(4, sq, occupied) | rayAttacks(5, sq, occupied);
+}
+
+constexpr Bitboard queenAttacks(int sq, Bitboard occupied) {
+	return bishopAttacks(sq, occupied) | rookAttacks(sq, occupied);
+}
+
+static_assert(popCount(knightAttacks(0)) == 2 && popCount(knightAttacks(squareOf(3, 3))) == 8, "knight table");
+static_assert(betweenBB(squareOf(7, 0), squareOf(7, 3)) == (squareBB(squareOf(7, 1)) | squareBB(squareOf(7, 2))), "between table");
+static_assert(popCount(lineBB(0, 63)) == 8 && betweenBB(0, 10) == 0, "line table");
@@ -0,0 +1,154 @@
+#include "BatchAnalyzer.h"
+#include <algorithm>
+
+
+// long enough runs that a game's plies stay together, short enough to keep every worker busy
+static const size_t MAX_CHUNK = 8;
+
+BatchAnalyzer::BatchAnalyzer(int threads, size_t hashMb)
+    : m_tt(hashMb), m_batch(0), m_running(0), m_quit(false), m_positions(nullptr), m_limits(nullptr),
+    m_onResult(nullptr), m_chunkSize(1), m_chunkCount(0), m_nextChunk(0) {
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < threads; i++) {
+        m_searchers.push_back(std::make_unique<Searcher>(&m_tt));
+    }
+    for (int i = 0; i < threads; i++) {
+        m_workers.emplace_back(&BatchAnalyzer::workerLoop, this, i);
+    }
+}
+
+BatchAnalyzer::~BatchAnalyzer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+int BatchAnalyzer::threads() const {
+    return static_cast<int>(m_workers.size());
+}
+
+TranspositionTable& BatchAnalyzer::table() {
+    return m_tt;
+}
+
+void BatchAnalyzer::setTablebase(const Tablebase* tablebase) {
+    std::lock_guard<std::mutex> batchLock(m_batchMutex);
+    for (auto& searcher : m_searchers) {
+        searcher->setTablebase(tablebase);
+    }
+}
+
+void BatchAnalyzer::analyze(const std::vector<BoardState>& positions, const SearchLimits& limits, const ResultCallback& onResult) {
+    if (positions.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> batchLock(m_batchMutex);
+
+    // the whole batch is one search as far as table ageing goes, so no position evicts another's entries
+    m_tt.newSearch();
+    m_positions = &positions;
+    m_limits = &limits;
+    m_onResult = &onResult;
+    m_chunkSize = std::clamp(positions.size() / (m_workers.size() * 4), size_t(1), MAX_CHUNK);
+    m_chunkCount = (positions.size() + m_chunkSize - 1) / m_chunkSize;
+    m_nextChunk = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_running = static_cast<int>(m_workers.size());
+    m_batch++;
+    m_wake.notify_all();
+    m_done.wait(lock, [this] { return m_running == 0; });
+}
+
+void BatchAnalyzer::analyzeGame(const BoardState& start, const MoveHistory& history, const SearchLimits& limits, const ResultCallback& onResult) {
+    analyze(replay(start, history), limits, onResult);
+}
+
+void BatchAnalyzer::analyzeGame(const GameSnapshot& start, const MoveHistory& history, const SearchLimits& limits, const ResultCallback& onResult) {
+    analyze(replay(start, history), limits, onResult);
+}
+
+static std::vector<BoardState> replayFrom(BoardState board, MoveHistory::const_iterator first, MoveHistory::const_iterator last) {
+    std::vector<BoardState> positions;
+    positions.reserve(static_cast<size_t>(last - first) + 1);
+    positions.push_back(board);
+    for (; first != last; ++first) {
+        EngineMove engineMove = board.findMove(*first);
+        if (engineMove.isNull()) {
+            break;
+        }
+        UndoInfo undo;
+        board.makeMove(engineMove, undo);
+        positions.push_back(board);
+    }
+    return positions;
+}
+
+std::vector<BoardState> BatchAnalyzer::replay(const BoardState& start, const MoveHistory& history) {
+    return replayFrom(start, history.begin(), history.end());
+}
+
+std::vector<BoardState> BatchAnalyzer::replay(const GameSnapshot& start, const MoveHistory& history) {
+    auto first = history.begin();
+    // the side to move never moves from the square the last move left, so this is only ever that move
+    if (first != history.end() && start.lastFrom >= 0 && squareOf(first->m_from.row, first->m_from.col) == start.lastFrom &&
+        squareOf(first->m_to.row, first->m_to.col) == start.lastTo) {
+        ++first;
+    }
+    return replayFrom(start.position, first, history.end());
+}
+
+void BatchAnalyzer::workerLoop(int index) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this, seen] { return m_quit || m_batch != seen; });
+            if (m_quit) {
+                return;
+            }
+            seen = m_batch;
+        }
+
+        runChunks(*m_searchers[index]);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_running == 0) {
+            m_done.notify_all();
+        }
+    }
+}
+
+void BatchAnalyzer::runChunks(Searcher& searcher) {
+    const std::vector<BoardState>& positions = *m_positions;
+    while (true) {
+        size_t chunk = m_nextChunk++;
+        if (chunk >= m_chunkCount) {
+            return;
+        }
+        size_t begin = chunk * m_chunkSize;
+        size_t end = std::min(begin + m_chunkSize, positions.size());
+
+        // last ply first, so each search finds the reply to its best move already in the table
+        for (size_t i = end; i-- > begin;) {
+            SearchResult found = searcher.search(positions[i], *m_limits);
+            AnalysisResult result;
+            result.index = i;
+            result.bestMove = found.bestMove;
+            result.score = found.score;
+            result.depth = found.depth;
+            result.nodes = found.nodes;
+            result.pv = std::move(found.pv);
+
+            std::lock_guard<std::mutex> lock(m_callbackMutex);
+            (*m_onResult)(result);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "BoardState.h"
+#include "GameSnapshot.h"
+#include "Search.h"
+#include "TranspositionTable.h"
+
+struct AnalysisResult {
+	size_t index = 0;        // position's place in the batch, the ply for a game
+	EngineMove bestMove;     // null when the side to move is mated or stalemated
+	int score = 0;           // centipawns from the side to move
+	int depth = 0;
+	uint64_t nodes = 0;
+	std::vector<EngineMove> pv;
+};
+
+// Best move and score for many positions at once. A fixed pool of workers, each with its own
+// Searcher, shares one table. A batch is handed out in short runs of consecutive positions, and
+// each run is searched from its last position back to its first. Consecutive plies of a game then
+// land on the same worker, and the position after a move is already in the table when the
+// position before it is searched.
+class BatchAnalyzer {
+public:
+	using ResultCallback = std::function<void(const AnalysisResult&)>;
+
+	// threads <= 0 uses every core
+	BatchAnalyzer(int threads = 0, size_t hashMb = 64);
+	~BatchAnalyzer();
+
+	BatchAnalyzer(const BatchAnalyzer&) = delete;
+	BatchAnalyzer& operator=(const BatchAnalyzer&) = delete;
+
+	// returns once every position is done. onResult gets each result as soon as it is ready, in
+	// completion order, from the worker threads but never from two at once
+	void analyze(const std::vector<BoardState>& positions, const SearchLimits& limits, const ResultCallback& onResult);
+
+	// every position of a game, from start to the one after the last move; start is the position
+	// before the history's first move, BoardState::startPosition() for a standard game
+	void analyzeGame(const BoardState& start, const MoveHistory& history, const SearchLimits& limits, const ResultCallback& onResult);
+	// the same for a Game started or forked from a snapshot, with its history as getHistory gives it:
+	// a first move that led to the snapshot is skipped
+	void analyzeGame(const GameSnapshot& start, const MoveHistory& history, const SearchLimits& limits, const ResultCallback& onResult);
+
+	// the position before each move and the one after the last, stopping at the first illegal move
+	static std::vector<BoardState> replay(const BoardState& start, const MoveHistory& history);
+	static std::vector<BoardState> replay(const GameSnapshot& start, const MoveHistory& history);
+
+	int threads() const;
+	TranspositionTable& table();
+
+	// only call between batches
+	void setTablebase(const Tablebase* tablebase);
+
+private:
+	void workerLoop(int index);
+	void runChunks(Searcher& searcher);
+
+	TranspositionTable m_tt;
+	std::vector<std::unique_ptr<Searcher>> m_searchers;
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_batchMutex;     // one batch at a time
+	std::mutex m_callbackMutex;
+	std::mutex m_mutex;          // guards the batch hand-off below
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t m_batch;
+	int m_running;
+	bool m_quit;
+
+	// the batch in progress
+	const std::vector<BoardState>* m_positions;
+	const SearchLimits* m_limits;
+	const ResultCallback* m_onResult;
+	size_t m_chunkSize;
+	size_t m_chunkCount;
+	std::atomic<size_t> m_nextChunk;
+};
@@ -0,0 +1,1114 @@
+#include "BoardState.h"
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+
+// Zobrist keys from a fixed seed so hashes are stable between runs, generated at compile time
+struct ZobristKeys {
+    uint64_t pieces[16][64];
+    uint64_t castling[16];
+    uint64_t ep[8];
+    uint64_t side;
+    uint64_t checks[2][4];   // by checks given, none hashing to 0 so other variants' keys are unchanged
+};
+
+static constexpr ZobristKeys makeZobristKeys() {
+    ZobristKeys keys{};
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    auto next = [&seed]() {
+        // splitmix64
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    };
+    for (auto& piece : keys.pieces) {
+        for (uint64_t& sq : piece) {
+            sq = next();
+        }
+    }
+    for (uint64_t& rights : keys.castling) {
+        rights = next();
+    }
+    for (uint64_t& file : keys.ep) {
+        file = next();
+    }
+    keys.side = next();
+    for (auto& given : keys.checks) {
+        for (int count = 1; count < 4; count++) {
+            given[count] = next();
+        }
+    }
+    return keys;
+}
+
+static constexpr ZobristKeys ZOBRIST = makeZobristKeys();
+
+// promotion flags start at 8 and follow the order of the promotion prompt in Game::makeMove
+static const Piece::PieceType::Type promotionPieces[4] = {
+    Piece::PieceType::QUEEN, Piece::PieceType::KNIGHT, Piece::PieceType::BISHOP, Piece::PieceType::ROOK
+};
+
+EngineMove::EngineMove(int from, int to, PositionType::MoveType mtype, Piece::PieceType::Type promotion) {
+    int flag = static_cast<int>(mtype);
+    if (mtype == PositionType::MoveType::PROM) {
+        flag = 8;
+        for (int i = 0; i < 4; i++) {
+            if (promotionPieces[i] == promotion) {
+                flag = 8 + i;
+            }
+        }
+    }
+    data = static_cast<uint16_t>(from | (to << 6) | (flag << 12));
+}
+
+PositionType::MoveType EngineMove::mtype() const {
+    int flag = data >> 12;
+    return flag >= 8 ? PositionType::MoveType::PROM : static_cast<PositionType::MoveType>(flag);
+}
+
+Piece::PieceType::Type EngineMove::promotion() const {
+    int flag = data >> 12;
+    return flag >= 8 ? promotionPieces[flag - 8] : Piece::PieceType::PIECE;
+}
+
+Move EngineMove::toMove() const {
+    return Move(Position(rowOf(from()), colOf(from())), Position(rowOf(to()), colOf(to())),
+        mtype() == PositionType::MoveType::PROM ? promotion() : Piece::PieceType::PIECE);
+}
+
+static std::string squareName(int sq) {
+    return { static_cast<char>('a' + colOf(sq)), static_cast<char>('8' - rowOf(sq)) };
+}
+
+std::string EngineMove::toUci() const {
+    std::string uci = squareName(from()) + squareName(to());
+    if (mtype() == PositionType::MoveType::PROM) {
+        uci += "qnbr"[(data >> 12) - 8];
+    }
+    return uci;
+}
+
+BoardState::BoardState()
+    : byType{}, byColor{}, turn(Piece::Color::WHITE), castling(0), epSquare(-1), variant(Variant::STANDARD),
+    castlingRooks{ squareOf(7, 7), squareOf(7, 0), squareOf(0, 7), squareOf(0, 0) }, checks{}, key(0) {
+    squares.fill(NO_PIECE);
+}
+
+uint64_t BoardState::computeKey() const {
+    const ZobristKeys& keys = ZOBRIST;
+    uint64_t hash = keys.castling[castling];
+    for (int sq = 0; sq < 64; sq++) {
+        if (squares[sq] != NO_PIECE) {
+            hash ^= keys.pieces[squares[sq]][sq];
+        }
+    }
+    if (epSquare >= 0) {
+        hash ^= keys.ep[colOf(epSquare)];
+    }
+    if (turn == Piece::Color::BLACK) {
+        hash ^= keys.side;
+    }
+    for (int color = 0; color < 2; color++) {
+        hash ^= keys.checks[color][std::min<int>(checks[color], 3)];
+    }
+    return hash;
+}
+
+void BoardState::putPiece(uint8_t code, int sq) {
+    Bitboard bb = squareBB(sq);
+    key ^= ZOBRIST.pieces[code][sq];
+    eval.add(colorIndex(colorOf(code)), typeOf(code), sq);
+    squares[sq] = code;
+    byType[typeOf(code)] |= bb;
+    byType[Piece::PieceType::PIECE] |= bb;
+    byColor[colorIndex(colorOf(code))] |= bb;
+}
+
+void BoardState::removePiece(int sq) {
+    uint8_t code = squares[sq];
+    Bitboard bb = squareBB(sq);
+    key ^= ZOBRIST.pieces[code][sq];
+    eval.remove(colorIndex(colorOf(code)), typeOf(code), sq);
+    squares[sq] = NO_PIECE;
+    byType[typeOf(code)] &= ~bb;
+    byType[Piece::PieceType::PIECE] &= ~bb;
+    byColor[colorIndex(colorOf(code))] &= ~bb;
+}
+
+void BoardState::movePiece(int from, int to) {
+    uint8_t code = squares[from];
+    Bitboard fromTo = squareBB(from) | squareBB(to);
+    key ^= ZOBRIST.pieces[code][from] ^ ZOBRIST.pieces[code][to];
+    eval.move(colorIndex(colorOf(code)), typeOf(code), from, to);
+    squares[from] = NO_PIECE;
+    squares[to] = code;
+    byType[typeOf(code)] ^= fromTo;
+    byType[Piece::PieceType::PIECE] ^= fromTo;
+    byColor[colorIndex(colorOf(code))] ^= fromTo;
+}
+
+// back rank of Chess960 start n in Scharnagl's numbering: the bishops on a light and a dark square,
+// the queen on one of the six squares left, the knights on one of ten pairs of the five after
+// that, and rook, king and rook on the last three
+static std::string chess960BackRank(int n) {
+    static const int knightPairs[10][2] = { { 0, 1 }, { 0, 2 }, { 0, 3 }, { 0, 4 }, { 1, 2 }, { 1, 3 }, { 1, 4 }, { 2, 3 }, { 2, 4 }, { 3, 4 } };
+    std::string rank(8, ' ');
+    auto placeOnEmpty = [&rank](int index, char piece) {
+        for (char& square : rank) {
+            if (square == ' ' && index-- == 0) {
+                square = piece;
+                return;
+            }
+        }
+    };
+    rank[2 * (n % 4) + 1] = 'b';
+    n /= 4;
+    rank[2 * (n % 4)] = 'b';
+    n /= 4;
+    placeOnEmpty(n % 6, 'q');
+    n /= 6;
+    // the later knight first, so the earlier one's index still counts the same empty squares
+    placeOnEmpty(knightPairs[n][1], 'n');
+    placeOnEmpty(knightPairs[n][0], 'n');
+    placeOnEmpty(0, 'r');
+    placeOnEmpty(0, 'k');
+    placeOnEmpty(0, 'r');
+    return rank;
+}
+
+BoardState BoardState::startPosition(Variant variant, int chess960Index) {
+    std::string black = "rnbqkbnr";
+    if (variant == Variant::CHESS960) {
+        black = chess960BackRank((chess960Index % 960 + 960) % 960);
+    }
+    std::string white = black;
+    std::transform(white.begin(), white.end(), white.begin(), [](char c) { return static_cast<char>(c - 0x20); });
+    BoardState board;
+    fromFen(black + "/pppppppp/8/8/8/8/PPPPPPPP/" + white + " w KQkq - 0 1", board, variant);
+    return board;
+}
+
+BoardState BoardState::fromState(const std::vector<std::vector<Piece*>>& state, Piece::Color turn, const Move* lastMove, Variant variant) {
+    BoardState board;
+    board.turn = turn;
+    board.variant = variant;
+
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            Piece* piece = state[i][j];
+            if (piece != nullptr) {
+                board.putPiece(pieceCode(piece->getColor(), piece->getType().type), squareOf(i, j));
+            }
+        }
+    }
+
+    // castling is still available while the king and the rook have not moved; a rook promoted on
+    // the other side's back rank has not moved either, but is the wrong colour
+    auto unmoved = [&](int row, int col, Piece::PieceType::Type type) {
+        Piece* piece = state[row][col];
+        Piece::Color color = row == 7 ? Piece::Color::WHITE : Piece::Color::BLACK;
+        return piece != nullptr && piece->getType().type == type && piece->getColor() == color && !piece->hasMoved();
+    };
+    if (variant == Variant::CHESS960) {
+        // rooks never leave their starting square unmoved, so there is at most one on each side of the king
+        for (Piece::Color color : { Piece::Color::WHITE, Piece::Color::BLACK }) {
+            bool white = color == Piece::Color::WHITE;
+            int backRank = white ? 7 : 0;
+            for (int king = 0; king < 8; king++) {
+                if (!unmoved(backRank, king, Piece::PieceType::KING)) {
+                    continue;
+                }
+                for (int col = 0; col < 8; col++) {
+                    if (col != king && unmoved(backRank, col, Piece::PieceType::ROOK)) {
+                        uint8_t right = col > king ? (white ? WHITE_KCASTLE : BLACK_KCASTLE) : (white ? WHITE_QCASTLE : BLACK_QCASTLE);
+                        board.castling |= right;
+                        board.castlingRooks[castlingIndex(right)] = static_cast<int8_t>(squareOf(backRank, col));
+                    }
+                }
+            }
+        }
+    }
+    else {
+        if (unmoved(7, 4, Piece::PieceType::KING)) {
+            if (unmoved(7, 7, Piece::PieceType::ROOK)) board.castling |= WHITE_KCASTLE;
+            if (unmoved(7, 0, Piece::PieceType::ROOK)) board.castling |= WHITE_QCASTLE;
+        }
+        if (unmoved(0, 4, Piece::PieceType::KING)) {
+            if (unmoved(0, 7, Piece::PieceType::ROOK)) board.castling |= BLACK_KCASTLE;
+            if (unmoved(0, 0, Piece::PieceType::ROOK)) board.castling |= BLACK_QCASTLE;
+        }
+    }
+
+    if (lastMove) {
+        Piece* moved = state[lastMove->m_to.row][lastMove->m_to.col];
+        if (moved != nullptr && moved->getType().type == Piece::PieceType::PAWN &&
+            abs(lastMove->m_from.row - lastMove->m_to.row) == 2) {
+            board.turn = moved->getColor();
+            board.updateEpSquare(squareOf((lastMove->m_from.row + lastMove->m_to.row) / 2, lastMove->m_to.col));
+            board.turn = turn;
+        }
+    }
+    board.key = board.computeKey();
+    return board;
+}
+
+static uint8_t pieceFromChar(char c) {
+    Piece::Color color = (c >= 'a' && c <= 'z') ? Piece::Color::BLACK : Piece::Color::WHITE;
+    switch (c | 0x20) {
+    case 'p': return pieceCode(color, Piece::PieceType::PAWN);
+    case 'n': return pieceCode(color, Piece::PieceType::KNIGHT);
+    case 'b': return pieceCode(color, Piece::PieceType::BISHOP);
+    case 'r': return pieceCode(color, Piece::PieceType::ROOK);
+    case 'q': return pieceCode(color, Piece::PieceType::QUEEN);
+    case 'k': return pieceCode(color, Piece::PieceType::KING);
+    default: return NO_PIECE;
+    }
+}
+
+static char charFromPiece(uint8_t code) {
+    char c = " pkqrnb"[typeOf(code)];
+    return colorOf(code) == Piece::Color::WHITE ? static_cast<char>(c - 0x20) : c;
+}
+
+bool BoardState::fromFen(const std::string& fen, BoardState& out, Variant variant) {
+    std::istringstream stream(fen);
+    std::string placement, side, rights, ep;
+    if (!(stream >> placement >> side >> rights >> ep)) {
+        return false;
+    }
+
+    BoardState board;
+    board.variant = variant;
+    int row = 0, col = 0;
+    for (char c : placement) {
+        if (c == '/') {
+            row++;
+            col = 0;
+        }
+        else if (c >= '1' && c <= '8') {
+            col += c - '0';
+        }
+        else {
+            uint8_t code = pieceFromChar(c);
+            if (code == NO_PIECE || row > 7 || col > 7) {
+                return false;
+            }
+            board.putPiece(code, squareOf(row, col++));
+        }
+    }
+    if (popCount(board.pieces(Piece::Color::WHITE, Piece::PieceType::KING)) != 1 ||
+        popCount(board.pieces(Piece::Color::BLACK, Piece::PieceType::KING)) != 1) {
+        return false;
+    }
+
+    board.turn = (side == "b") ? Piece::Color::BLACK : Piece::Color::WHITE;
+    for (char c : rights) {
+        char lower = static_cast<char>(c | 0x20);
+        Piece::Color color = c == lower ? Piece::Color::BLACK : Piece::Color::WHITE;
+        int backRank = color == Piece::Color::WHITE ? 7 : 0;
+        int king = board.kingSquare(color);
+        uint8_t rook = pieceCode(color, Piece::PieceType::ROOK);
+        int rookSq = -1;
+        if (lower == 'k' || lower == 'q') {
+            // the outermost rook on that side of the king
+            int step = lower == 'k' ? -1 : 1;
+            for (int sq = squareOf(backRank, lower == 'k' ? 7 : 0); rowOf(king) == backRank && sq != king; sq += step) {
+                if (board.squares[sq] == rook) {
+                    rookSq = sq;
+                    break;
+                }
+            }
+        }
+        else if (lower >= 'a' && lower <= 'h' && board.squares[squareOf(backRank, lower - 'a')] == rook && rowOf(king) == backRank) {
+            rookSq = squareOf(backRank, lower - 'a');
+        }
+        if (rookSq >= 0) {
+            bool white = color == Piece::Color::WHITE;
+            uint8_t right = rookSq > king ? (white ? WHITE_KCASTLE : BLACK_KCASTLE) : (white ? WHITE_QCASTLE : BLACK_QCASTLE);
+            board.castling |= right;
+            board.castlingRooks[castlingIndex(right)] = static_cast<int8_t>(rookSq);
+        }
+    }
+    if (variant != Variant::CHESS960) {
+        // drop rights whose king or rook is not on its standard starting square
+        BoardState standard;
+        for (int i = 0; i < 4; i++) {
+            if (board.castlingRooks[i] != standard.castlingRooks[i]) {
+                board.castling &= ~(1 << i);
+                board.castlingRooks[i] = standard.castlingRooks[i];
+            }
+        }
+        if (board.squares[squareOf(7, 4)] != pieceCode(Piece::Color::WHITE, Piece::PieceType::KING)) board.castling &= ~(WHITE_KCASTLE | WHITE_QCASTLE);
+        if (board.squares[squareOf(0, 4)] != pieceCode(Piece::Color::BLACK, Piece::PieceType::KING)) board.castling &= ~(BLACK_KCASTLE | BLACK_QCASTLE);
+    }
+
+    if (ep.size() == 2) {
+        Piece::Color mover = opposite(board.turn);
+        board.turn = mover;
+        board.updateEpSquare(squareOf('8' - ep[1], ep[0] - 'a'));
+        board.turn = opposite(mover);
+    }
+
+    std::string field;
+    while (variant == Variant::THREE_CHECK && stream >> field) {
+        size_t plus = field.find('+', 1);
+        if (plus == std::string::npos) {
+            continue;
+        }
+        int white = std::atoi(field.c_str() + (field[0] == '+' ? 1 : 0));
+        int black = std::atoi(field.c_str() + plus + 1);
+        if (field[0] != '+') {
+            white = ThreeCheckRules::checksToWin - white;
+            black = ThreeCheckRules::checksToWin - black;
+        }
+        board.checks[colorIndex(Piece::Color::WHITE)] = static_cast<uint8_t>(std::clamp(white, 0, ThreeCheckRules::checksToWin));
+        board.checks[colorIndex(Piece::Color::BLACK)] = static_cast<uint8_t>(std::clamp(black, 0, ThreeCheckRules::checksToWin));
+    }
+
+    board.key = board.computeKey();
+    out = board;
+    return true;
+}
+
+std::string BoardState::toFen() const {
+    std::string fen;
+    for (int row = 0; row < 8; row++) {
+        int empty = 0;
+        for (int col = 0; col < 8; col++) {
+            uint8_t code = squares[squareOf(row, col)];
+            if (code == NO_PIECE) {
+                empty++;
+                continue;
+            }
+            if (empty) {
+                fen += static_cast<char>('0' + empty);
+                empty = 0;
+            }
+            fen += charFromPiece(code);
+        }
+        if (empty) {
+            fen += static_cast<char>('0' + empty);
+        }
+        if (row < 7) {
+            fen += '/';
+        }
+    }
+
+    fen += turn == Piece::Color::WHITE ? " w " : " b ";
+    for (int i = 0; i < 4; i++) {
+        if (castling & (1 << i)) {
+            // Chess960 names the rook's file, as Shredder-FEN does
+            char right = variant == Variant::CHESS960 ? static_cast<char>('a' + colOf(castlingRooks[i])) : "kqkq"[i];
+            fen += i < 2 ? static_cast<char>(right - 0x20) : right;
+        }
+    }
+    if (!castling) fen += '-';
+    fen += ' ';
+    fen += epSquare >= 0 ? squareName(epSquare) : "-";
+    if (variant == Variant::THREE_CHECK) {
+        // checks remaining, as lichess writes them
+        fen += ' ' + std::to_string(ThreeCheckRules::checksToWin - checks[0]) + '+' + std::to_string(ThreeCheckRules::checksToWin - checks[1]);
+    }
+    fen += " 0 1";
+    return fen;
+}
+
+bool BoardState::isSquareAttacked(int sq, Piece::Color by) const {
+    Bitboard occ = occupied();
+    Bitboard queens = pieces(by, Piece::PieceType::QUEEN);
+    return (pawnAttacks(opposite(by), sq) & pieces(by, Piece::PieceType::PAWN)) ||
+        (knightAttacks(sq) & pieces(by, Piece::PieceType::KNIGHT)) ||
+        (kingAttacks(sq) & pieces(by, Piece::PieceType::KING)) ||
+        (bishopAttacks(sq, occ) & (pieces(by, Piece::PieceType::BISHOP) | queens)) ||
+        (rookAttacks(sq, occ) & (pieces(by, Piece::PieceType::ROOK) | queens));
+}
+
+Bitboard BoardState::attackersTo(int sq, Bitboard occ) const {
+    Bitboard queens = byType[Piece::PieceType::QUEEN];
+    return (pawnAttacks(Piece::Color::BLACK, sq) & pieces(Piece::Color::WHITE, Piece::PieceType::PAWN)) |
+        (pawnAttacks(Piece::Color::WHITE, sq) & pieces(Piece::Color::BLACK, Piece::PieceType::PAWN)) |
+        (knightAttacks(sq) & byType[Piece::PieceType::KNIGHT]) |
+        (kingAttacks(sq) & byType[Piece::PieceType::KING]) |
+        (bishopAttacks(sq, occ) & (byType[Piece::PieceType::BISHOP] | queens)) |
+        (rookAttacks(sq, occ) & (byType[Piece::PieceType::ROOK] | queens));
+}
+
+bool BoardState::isPseudoLegal(EngineMove move) const {
+    int from = move.from();
+    int to = move.to();
+    uint8_t code = squares[from];
+    uint8_t target = squares[to];
+    if (move.isNull() || code == NO_PIECE || colorOf(code) != turn) {
+        return false;
+    }
+
+    // castling has too many conditions to repeat here, ask the generator; in Chess960 it can land on
+    // the side's own rook
+    PositionType::MoveType mtype = move.mtype();
+    if (mtype == PositionType::MoveType::KCASTLE || mtype == PositionType::MoveType::QCASTLE) {
+        MoveList list;
+        generateMoves(*this, GenType::QUIETS, list);
+        return std::find(list.begin(), list.end(), move) != list.end();
+    }
+    if (target != NO_PIECE && colorOf(target) == turn) {
+        return false;
+    }
+
+    if (typeOf(code) == Piece::PieceType::PAWN) {
+        int forward = (turn == Piece::Color::WHITE) ? -8 : 8;
+        int startRow = (turn == Piece::Color::WHITE) ? 6 : 1;
+        bool promotes = rowOf(to) == ((turn == Piece::Color::WHITE) ? 0 : 7);
+        bool diagonal = pawnAttacks(turn, from) & squareBB(to);
+
+        if (mtype == PositionType::MoveType::ENPASS) {
+            return diagonal && to == epSquare;
+        }
+        if (promotes != (mtype == PositionType::MoveType::PROM)) {
+            return false;
+        }
+        if (diagonal) {
+            return target != NO_PIECE && mtype != PositionType::MoveType::STND;
+        }
+        if (target != NO_PIECE || mtype == PositionType::MoveType::CAPT) {
+            return false;
+        }
+        return to == from + forward ||
+            (to == from + 2 * forward && rowOf(from) == startRow && squares[from + forward] == NO_PIECE);
+    }
+
+    if (mtype != (target == NO_PIECE ? PositionType::MoveType::STND : PositionType::MoveType::CAPT)) {
+        return false;
+    }
+    Bitboard attacks = 0;
+    switch (typeOf(code)) {
+    case Piece::PieceType::KNIGHT: attacks = knightAttacks(from); break;
+    case Piece::PieceType::BISHOP: attacks = bishopAttacks(from, occupied()); break;
+    case Piece::PieceType::ROOK: attacks = rookAttacks(from, occupied()); break;
+    case Piece::PieceType::QUEEN: attacks = queenAttacks(from, occupied()); break;
+    case Piece::PieceType::KING: attacks = kingAttacks(from); break;
+    default: break;
+    }
+    return attacks & squareBB(to);
+}
+
+// only record the en passant square when an enemy pawn could actually capture onto it, so that
+// positions differing only by an unusable en passant square compare equal
+void BoardState::updateEpSquare(int sq) {
+    if (pawnAttacks(turn, sq) & pieces(opposite(turn), Piece::PieceType::PAWN)) {
+        epSquare = static_cast<int8_t>(sq);
+        key ^= ZOBRIST.ep[colOf(sq)];
+    }
+}
+
+// castling rights that survive a move touching each square, with the kings and rooks on their
+// standard squares; Chess960 works them out from castlingRooks
+static const std::array<uint8_t, 64> castlingMasks = [] {
+    std::array<uint8_t, 64> masks;
+    masks.fill(WHITE_KCASTLE | WHITE_QCASTLE | BLACK_KCASTLE | BLACK_QCASTLE);
+    masks[squareOf(7, 4)] &= ~(WHITE_KCASTLE | WHITE_QCASTLE);
+    masks[squareOf(7, 7)] &= ~WHITE_KCASTLE;
+    masks[squareOf(7, 0)] &= ~WHITE_QCASTLE;
+    masks[squareOf(0, 4)] &= ~(BLACK_KCASTLE | BLACK_QCASTLE);
+    masks[squareOf(0, 7)] &= ~BLACK_KCASTLE;
+    masks[squareOf(0, 0)] &= ~BLACK_QCASTLE;
+    return masks;
+}();
+
+template <typename Rules>
+static bool insufficientUnder(const BoardState& board) {
+    const Bitboard* byType = board.byType;
+    if constexpr (Rules::hill != 0) {
+        return false;
+    }
+    else if constexpr (Rules::checksToWin != 0) {
+        return board.occupied() == byType[Piece::PieceType::KING];
+    }
+    else {
+        if (byType[Piece::PieceType::PAWN] | byType[Piece::PieceType::ROOK] | byType[Piece::PieceType::QUEEN]) {
+            return false;
+        }
+        Bitboard knights = byType[Piece::PieceType::KNIGHT];
+        Bitboard bishops = byType[Piece::PieceType::BISHOP];
+        if (popCount(knights | bishops) <= 1) {
+            return true;
+        }
+        const Bitboard lightSquares = 0x55AA55AA55AA55AAULL;
+        return !knights && (!(bishops & lightSquares) || !(bishops & ~lightSquares));
+    }
+}
+
+bool BoardState::insufficientMaterial() const {
+    switch (variant) {
+    case Variant::KING_OF_THE_HILL: return insufficientUnder<KingOfTheHillRules>(*this);
+    case Variant::THREE_CHECK: return insufficientUnder<ThreeCheckRules>(*this);
+    default: return insufficientUnder<StandardRules>(*this);
+    }
+}
+
+void BoardState::makeMove(EngineMove move, UndoInfo& undo) {
+    int from = move.from();
+    int to = move.to();
+    int backRank = rowOf(from);
+    Piece::PieceType::Type movedType = typeOf(squares[from]);
+
+    undo.move = move;
+    undo.captured = NO_PIECE;
+    undo.castling = castling;
+    undo.epSquare = epSquare;
+    undo.checks[0] = checks[0];
+    undo.checks[1] = checks[1];
+    undo.key = key;
+    if (epSquare >= 0) {
+        key ^= ZOBRIST.ep[colOf(epSquare)];
+        epSquare = -1;
+    }
+
+    switch (move.mtype()) {
+    case PositionType::MoveType::STND:
+        movePiece(from, to);
+        if (typeOf(squares[to]) == Piece::PieceType::PAWN && abs(to - from) == 16) {
+            updateEpSquare((from + to) / 2);
+        }
+        break;
+
+    case PositionType::MoveType::CAPT:
+        undo.captured = squares[to];
+        removePiece(to);
+        movePiece(from, to);
+        break;
+
+    case PositionType::MoveType::ENPASS: {
+        int capturedSq = to + (turn == Piece::Color::WHITE ? 8 : -8);
+        undo.captured = squares[capturedSq];
+        removePiece(capturedSq);
+        movePiece(from, to);
+        break;
+    }
+
+    case PositionType::MoveType::KCASTLE:
+    case PositionType::MoveType::QCASTLE: {
+        // both pieces come off first, since in Chess960 either may land where the other stood
+        bool kingSide = move.mtype() == PositionType::MoveType::KCASTLE;
+        int rook = castlingRooks[castlingIndex(castlingRight(turn, kingSide))];
+        uint8_t king = squares[from];
+        uint8_t rookCode = squares[rook];
+        removePiece(from);
+        removePiece(rook);
+        putPiece(king, squareOf(backRank, kingSide ? 6 : 2));
+        putPiece(rookCode, squareOf(backRank, kingSide ? 5 : 3));
+        break;
+    }
+
+    case PositionType::MoveType::PROM:
+        if (squares[to] != NO_PIECE) {
+            undo.captured = squares[to];
+            removePiece(to);
+        }
+        removePiece(from);
+        putPiece(pieceCode(turn, move.promotion()), to);
+        break;
+    }
+
+    key ^= ZOBRIST.castling[castling];
+    if (variant == Variant::CHESS960) {
+        // kings and rooks start anywhere on the back rank, so the rights are looked up by square
+        for (int i = 0; i < 4; i++) {
+            if (castlingRooks[i] == from || castlingRooks[i] == to) {
+                castling &= ~(1 << i);
+            }
+        }
+        if (movedType == Piece::PieceType::KING) {
+            castling &= ~(castlingRight(turn, true) | castlingRight(turn, false));
+        }
+    }
+    else {
+        castling &= castlingMasks[from] & castlingMasks[to];
+    }
+    key ^= ZOBRIST.castling[castling] ^ ZOBRIST.side;
+    turn = opposite(turn);
+
+    if (variant == Variant::THREE_CHECK && inCheck()) {
+        uint8_t& given = checks[colorIndex(opposite(turn))];
+        key ^= ZOBRIST.checks[colorIndex(opposite(turn))][std::min<int>(given, 3)];
+        given++;
+        key ^= ZOBRIST.checks[colorIndex(opposite(turn))][std::min<int>(given, 3)];
+    }
+}
+
+
+void BoardState::unmakeMove(const UndoInfo& undo) {
+    turn = opposite(turn);
+    castling = undo.castling;
+    epSquare = undo.epSquare;
+    checks[0] = undo.checks[0];
+    checks[1] = undo.checks[1];
+
+    EngineMove move = undo.move;
+    int from = move.from();
+    int to = move.to();
+    int backRank = rowOf(from);
+
+    switch (move.mtype()) {
+    case PositionType::MoveType::STND:
+    case PositionType::MoveType::CAPT:
+        movePiece(to, from);
+        if (undo.captured != NO_PIECE) {
+            putPiece(undo.captured, to);
+        }
+        break;
+
+    case PositionType::MoveType::ENPASS:
+        movePiece(to, from);
+        putPiece(undo.captured, to + (turn == Piece::Color::WHITE ? 8 : -8));
+        break;
+
+    case PositionType::MoveType::KCASTLE:
+    case PositionType::MoveType::QCASTLE: {
+        bool kingSide = move.mtype() == PositionType::MoveType::KCASTLE;
+        int kingTo = squareOf(backRank, kingSide ? 6 : 2);
+        int rookTo = squareOf(backRank, kingSide ? 5 : 3);
+        uint8_t king = squares[kingTo];
+        uint8_t rook = squares[rookTo];
+        removePiece(kingTo);
+        removePiece(rookTo);
+        putPiece(king, from);
+        putPiece(rook, castlingRooks[castlingIndex(castlingRight(turn, kingSide))]);
+        break;
+    }
+
+    case PositionType::MoveType::PROM:
+        removePiece(to);
+        putPiece(pieceCode(turn, Piece::PieceType::PAWN), from);
+        if (undo.captured != NO_PIECE) {
+            putPiece(undo.captured, to);
+        }
+        break;
+    }
+    key = undo.key;
+}
+
+EngineMove BoardState::findMove(const Move& move, Piece::PieceType::Type promotion) const {
+    if (move.m_promotion != Piece::PieceType::PIECE) {
+        promotion = move.m_promotion;
+    }
+    BoardState copy = *this;
+    MoveList list;
+    generateLegalMoves(copy, list);
+    for (EngineMove candidate : list) {
+        if (candidate.from() == squareOf(move.m_from.row, move.m_from.col) &&
+            candidate.to() == squareOf(move.m_to.row, move.m_to.col) &&
+            (candidate.mtype() != PositionType::MoveType::PROM || candidate.promotion() == promotion)) {
+            return candidate;
+        }
+    }
+    return EngineMove();
+}
+
+static void pushPieceMoves(const BoardState& board, int from, Bitboard targets, MoveList& list) {
+    while (targets) {
+        int to = popLsb(targets);
+        list.push(EngineMove(from, to, board.squares[to] == NO_PIECE ? PositionType::MoveType::STND : PositionType::MoveType::CAPT));
+    }
+}
+
+template <bool Captures, bool Quiets>
+static void pushPromotions(int from, int to, MoveList& list) {
+    if (Captures) {
+        list.push(EngineMove(from, to, PositionType::MoveType::PROM, Piece::PieceType::QUEEN));
+    }
+    if (Quiets) {
+        list.push(EngineMove(from, to, PositionType::MoveType::PROM, Piece::PieceType::KNIGHT));
+        list.push(EngineMove(from, to, PositionType::MoveType::PROM, Piece::PieceType::BISHOP));
+        list.push(EngineMove(from, to, PositionType::MoveType::PROM, Piece::PieceType::ROOK));
+    }
+}
+
+constexpr Bitboard FILE_A = 0x0101010101010101ULL;
+constexpr Bitboard FILE_H = FILE_A << 7;
+constexpr Bitboard ROW_0 = 0xFFULL;
+constexpr Bitboard ROW_7 = ROW_0 << 56;
+
+// every pawn of a set one square forward, white moving towards row 0
+template <Piece::Color Us>
+constexpr Bitboard pawnPush(Bitboard pawns) {
+    return Us == Piece::Color::WHITE ? pawns >> 8 : pawns << 8;
+}
+
+// pawns and the squares they reach, a whole set at a time with shifts instead of a loop over pawns
+// asking which way they move
+template <Piece::Color Us, GenType Type>
+static void generatePawnMoves(const BoardState& board, Bitboard blockTargets, Bitboard captureTargets, MoveList& list) {
+    constexpr Piece::Color Them = Us == Piece::Color::WHITE ? Piece::Color::BLACK : Piece::Color::WHITE;
+    constexpr int forward = Us == Piece::Color::WHITE ? -8 : 8;
+    constexpr Bitboard promotionRow = Us == Piece::Color::WHITE ? ROW_0 : ROW_7;
+    constexpr Bitboard doublePushRow = Us == Piece::Color::WHITE ? ROW_7 >> 16 : ROW_0 << 16;  // where a single push from the start lands
+    constexpr bool quiets = Type != GenType::CAPTURES;
+    constexpr bool captures = Type != GenType::QUIETS;
+
+    Bitboard pawns = board.pieces(Us, Piece::PieceType::PAWN);
+    Bitboard empty = ~board.occupied();
+
+    // the queen push promotion goes with the captures so quiescence sees it, the others with the quiets
+    Bitboard single = pawnPush<Us>(pawns) & empty;
+    Bitboard promotions = single & promotionRow & blockTargets;
+    while (promotions) {
+        int to = popLsb(promotions);
+        pushPromotions<captures, quiets>(to - forward, to, list);
+    }
+    if constexpr (quiets) {
+        Bitboard doubles = pawnPush<Us>(single & doublePushRow) & empty & blockTargets;
+        Bitboard pushes = single & ~promotionRow & blockTargets;
+        while (pushes) {
+            int to = popLsb(pushes);
+            list.push(EngineMove(to - forward, to, PositionType::MoveType::STND));
+        }
+        while (doubles) {
+            int to = popLsb(doubles);
+            list.push(EngineMove(to - 2 * forward, to, PositionType::MoveType::STND)); // double move if pawn has not moved
+        }
+    }
+
+    if constexpr (captures) {
+        // towards column 0 and towards column 7, pawns on the edge file in that direction cannot
+        Bitboard enemy = board.byColor[colorIndex(Them)] & captureTargets;
+        constexpr int towardsA = forward - 1;
+        constexpr int towardsH = forward + 1;
+        Bitboard left = (Us == Piece::Color::WHITE ? (pawns & ~FILE_A) >> 9 : (pawns & ~FILE_A) << 7) & enemy;
+        Bitboard right = (Us == Piece::Color::WHITE ? (pawns & ~FILE_H) >> 7 : (pawns & ~FILE_H) << 9) & enemy;
+        for (int side = 0; side < 2; side++) {
+            Bitboard targets = side == 0 ? left : right;
+            int step = side == 0 ? towardsA : towardsH;
+            while (targets) {
+                int to = popLsb(targets);
+                if (squareBB(to) & promotionRow) {
+                    pushPromotions<true, true>(to - step, to, list);
+                }
+                else {
+                    list.push(EngineMove(to - step, to, PositionType::MoveType::CAPT));
+                }
+            }
+        }
+
+        if (board.epSquare >= 0) {
+            // the captured pawn stands one row behind the square; in check the capture must take
+            // the checker or land between it and the king
+            int victim = board.epSquare - forward;
+            if ((squareBB(board.epSquare) & blockTargets) || (squareBB(victim) & captureTargets)) {
+                Bitboard takers = pawnAttacks(Them, board.epSquare) & pawns;
+                while (takers) {
+                    list.push(EngineMove(popLsb(takers), board.epSquare, PositionType::MoveType::ENPASS));
+                }
+            }
+        }
+    }
+}
+
+// squares from a to b along one row, both included
+static Bitboard rowSpan(int a, int b) {
+    return betweenBB(a, b) | squareBB(a) | squareBB(b);
+}
+
+// what castling to one side takes
+struct CastlingSquares {
+    int rook;        // where the rook starts
+    int kingTo;
+    int rookTo;
+    int target;      // the move's destination, castlingTarget
+    Bitboard empty;  // must hold nothing but the king and the rook
+    Bitboard path;   // the king's squares from start to finish, none of which may be attacked
+};
+
+// with standard rules the king and rook squares are constants, so everything folds away
+template <Piece::Color Us, typename Rules>
+static CastlingSquares castlingSquares(const BoardState& board, int king, bool kingSide) {
+    constexpr int backRank = Us == Piece::Color::WHITE ? 7 : 0;
+    int kingTo = squareOf(backRank, kingSide ? 6 : 2);
+    int rookTo = squareOf(backRank, kingSide ? 5 : 3);
+    if constexpr (Rules::anyCastlingFiles) {
+        int rook = board.castlingRooks[castlingIndex(castlingRight(Us, kingSide))];
+        Bitboard path = rowSpan(king, kingTo);
+        return { rook, kingTo, rookTo, castlingTarget(king, rook), (path | rowSpan(rook, rookTo)) & ~squareBB(king) & ~squareBB(rook), path };
+    }
+    else {
+        constexpr int kingFrom = squareOf(backRank, 4);
+        int rook = squareOf(backRank, kingSide ? 7 : 0);
+        return { rook, kingTo, rookTo, kingTo, betweenBB(kingFrom, rook), rowSpan(kingFrom, kingTo) };
+    }
+}
+
+template <Piece::Color Us, GenType Type, typename Rules>
+static void generateMovesFor(const BoardState& board, MoveList& list) {
+    constexpr Piece::Color Them = Us == Piece::Color::WHITE ? Piece::Color::BLACK : Piece::Color::WHITE;
+    Bitboard occ = board.occupied();
+    Bitboard enemy = board.byColor[colorIndex(Them)];
+    Bitboard own = board.byColor[colorIndex(Us)];
+    int king = board.kingSquare(Us);
+
+    Bitboard targets;
+    if constexpr (Type == GenType::CAPTURES) {
+        targets = enemy;
+    }
+    else if constexpr (Type == GenType::QUIETS) {
+        targets = ~occ;
+    }
+    else {
+        targets = ~own;
+    }
+
+    if constexpr (Type == GenType::EVASIONS) {
+        // in double check only the king can move; otherwise the others must take or block the checker
+        Bitboard checkers = board.checkers();
+        pushPieceMoves(board, king, kingAttacks(king) & ~own, list);
+        if (popCount(checkers) > 1) {
+            return;
+        }
+        int checker = lsb(checkers);
+        targets = betweenBB(king, checker) | checkers;
+    }
+
+    // only evasions restrict where a pawn may push to
+    generatePawnMoves<Us, Type>(board, Type == GenType::EVASIONS ? targets : ~Bitboard(0), targets, list);
+
+    Bitboard knights = board.pieces(Us, Piece::PieceType::KNIGHT);
+    while (knights) {
+        int from = popLsb(knights);
+        pushPieceMoves(board, from, knightAttacks(from) & targets, list);
+    }
+    Bitboard bishops = board.pieces(Us, Piece::PieceType::BISHOP);
+    while (bishops) {
+        int from = popLsb(bishops);
+        pushPieceMoves(board, from, bishopAttacks(from, occ) & targets, list);
+    }
+    Bitboard rooks = board.pieces(Us, Piece::PieceType::ROOK);
+    while (rooks) {
+        int from = popLsb(rooks);
+        pushPieceMoves(board, from, rookAttacks(from, occ) & targets, list);
+    }
+    Bitboard queens = board.pieces(Us, Piece::PieceType::QUEEN);
+    while (queens) {
+        int from = popLsb(queens);
+        pushPieceMoves(board, from, queenAttacks(from, occ) & targets, list);
+    }
+
+    if constexpr (Type != GenType::EVASIONS) {
+        pushPieceMoves(board, king, kingAttacks(king) & targets, list);
+    }
+
+    if constexpr (Type == GenType::QUIETS || Type == GenType::ALL) {
+        // castling: the squares the king and rook cross must be empty and the king may not start on,
+        // pass through or land on an attacked square
+        for (bool kingSide : { true, false }) {
+            if (!(board.castling & castlingRight(Us, kingSide))) {
+                continue;
+            }
+            CastlingSquares castle = castlingSquares<Us, Rules>(board, king, kingSide);
+            bool safe = !(occ & castle.empty);
+            for (Bitboard path = castle.path; safe && path;) {
+                safe = !board.isSquareAttacked(popLsb(path), Them);
+            }
+            if (safe) {
+                list.push(EngineMove(king, castle.target, kingSide ? PositionType::MoveType::KCASTLE : PositionType::MoveType::QCASTLE));
+            }
+        }
+    }
+}
+
+template <Piece::Color Us, typename Rules>
+static void generateMovesFor(const BoardState& board, GenType type, MoveList& list) {
+    switch (type) {
+    case GenType::CAPTURES: generateMovesFor<Us, GenType::CAPTURES, Rules>(board, list); break;
+    case GenType::QUIETS:   generateMovesFor<Us, GenType::QUIETS, Rules>(board, list); break;
+    case GenType::EVASIONS: generateMovesFor<Us, GenType::EVASIONS, Rules>(board, list); break;
+    case GenType::ALL:      generateMovesFor<Us, GenType::ALL, Rules>(board, list); break;
+    }
+}
+
+template <typename Rules>
+static void generateMovesAs(const BoardState& board, GenType type, MoveList& list) {
+    if (board.turn == Piece::Color::WHITE) {
+        generateMovesFor<Piece::Color::WHITE, Rules>(board, type, list);
+    }
+    else {
+        generateMovesFor<Piece::Color::BLACK, Rules>(board, type, list);
+    }
+}
+
+// one specialised kernel per side, stage and castling rule, picked once here instead of branching
+// inside the loops; the other variants only change how a game ends and share the standard kernels
+void generateMoves(const BoardState& board, GenType type, MoveList& list) {
+    if (board.variant == Variant::CHESS960) {
+        generateMovesAs<Chess960Rules>(board, type, list);
+    }
+    else {
+        generateMovesAs<StandardRules>(board, type, list);
+    }
+}
+
+void generateLegalMoves(BoardState& board, MoveList& list) {
+    MoveList pseudo;
+    generateMoves(board, board.inCheck() ? GenType::EVASIONS : GenType::ALL, pseudo);
+
+    Piece::Color us = board.turn;
+    for (EngineMove move : pseudo) {
+        UndoInfo undo;
+        board.makeMove(move, undo);
+        if (!board.isSquareAttacked(board.kingSquare(us), opposite(us))) {
+            list.push(move);
+        }
+        board.unmakeMove(undo);
+    }
+}
+
+// every square a side attacks given an occupancy, pawns a whole set at a time
+template <Piece::Color Them>
+static Bitboard attackedSquares(const BoardState& board, Bitboard occ) {
+    Bitboard pawns = board.pieces(Them, Piece::PieceType::PAWN);
+    Bitboard attacked = Them == Piece::Color::WHITE ? ((pawns & ~FILE_A) >> 9) | ((pawns & ~FILE_H) >> 7)
+                                                    : ((pawns & ~FILE_A) << 7) | ((pawns & ~FILE_H) << 9);
+    attacked |= kingAttacks(board.kingSquare(Them));
+    Bitboard knights = board.pieces(Them, Piece::PieceType::KNIGHT);
+    while (knights) {
+        attacked |= knightAttacks(popLsb(knights));
+    }
+    Bitboard queens = board.pieces(Them, Piece::PieceType::QUEEN);
+    Bitboard diagonal = board.pieces(Them, Piece::PieceType::BISHOP) | queens;
+    while (diagonal) {
+        attacked |= bishopAttacks(popLsb(diagonal), occ);
+    }
+    Bitboard orthogonal = board.pieces(Them, Piece::PieceType::ROOK) | queens;
+    while (orthogonal) {
+        attacked |= rookAttacks(popLsb(orthogonal), occ);
+    }
+    return attacked;
+}
+
+template <Piece::Color Us, typename Rules>
+static void generateLegalMaskFor(const BoardState& board, LegalMask& mask) {
+    constexpr Piece::Color Them = Us == Piece::Color::WHITE ? Piece::Color::BLACK : Piece::Color::WHITE;
+    constexpr int forward = Us == Piece::Color::WHITE ? -8 : 8;
+    constexpr int startRow = Us == Piece::Color::WHITE ? 6 : 1;
+    Bitboard occ = board.occupied();
+    Bitboard own = board.byColor[colorIndex(Us)];
+    Bitboard enemy = board.byColor[colorIndex(Them)];
+    Bitboard enemyDiagonal = board.pieces(Them, Piece::PieceType::BISHOP) | board.pieces(Them, Piece::PieceType::QUEEN);
+    Bitboard enemyOrthogonal = board.pieces(Them, Piece::PieceType::ROOK) | board.pieces(Them, Piece::PieceType::QUEEN);
+    int king = board.kingSquare(Us);
+
+    for (Bitboard& destinations : mask.destinations) {
+        destinations = 0;
+    }
+
+    // the king is lifted off the board first so it cannot step back along the line of a slider
+    Bitboard danger = attackedSquares<Them>(board, occ ^ squareBB(king));
+    mask.destinations[king] = kingAttacks(king) & ~own & ~danger;
+    Bitboard checkers = board.checkers();
+    if (popCount(checkers) > 1) {
+        return;
+    }
+
+    // the others must take or block a single checker, and pinned pieces stay on their pin line
+    Bitboard checkMask = checkers ? betweenBB(king, lsb(checkers)) | checkers : ~Bitboard(0);
+    Bitboard pinned = 0;
+    Bitboard snipers = (bishopAttacks(king, 0) & enemyDiagonal) | (rookAttacks(king, 0) & enemyOrthogonal);
+    while (snipers) {
+        Bitboard blockers = betweenBB(king, popLsb(snipers)) & occ;
+        if (popCount(blockers) == 1) {
+            pinned |= blockers & own;
+        }
+    }
+
+    Bitboard pieces = own & ~squareBB(king);
+    while (pieces) {
+        int from = popLsb(pieces);
+        Bitboard targets;
+        switch (typeOf(board.squares[from])) {
+        case Piece::PieceType::KNIGHT: targets = knightAttacks(from) & ~own; break;
+        case Piece::PieceType::BISHOP: targets = bishopAttacks(from, occ) & ~own; break;
+        case Piece::PieceType::ROOK: targets = rookAttacks(from, occ) & ~own; break;
+        case Piece::PieceType::QUEEN: targets = queenAttacks(from, occ) & ~own; break;
+        default: {
+            targets = pawnAttacks(Us, from) & enemy;
+            int one = from + forward;
+            if (board.squares[one] == NO_PIECE) {
+                targets |= squareBB(one);
+                if (rowOf(from) == startRow && board.squares[one + forward] == NO_PIECE) {
+                    targets |= squareBB(one + forward);
+                }
+            }
+            // en passant empties two squares of one row, which no pin test sees, so it is tried on
+            // the occupancy it leaves behind
+            if (board.epSquare >= 0 && (pawnAttacks(Us, from) & squareBB(board.epSquare))) {
+                int victim = board.epSquare - forward;
+                Bitboard after = (occ ^ squareBB(from) ^ squareBB(victim)) | squareBB(board.epSquare);
+                bool safe = !(checkers & ~squareBB(victim) & ~enemyDiagonal & ~enemyOrthogonal) &&
+                    !(bishopAttacks(king, after) & enemyDiagonal) && !(rookAttacks(king, after) & enemyOrthogonal & ~squareBB(victim));
+                if (safe) {
+                    mask.destinations[from] |= squareBB(board.epSquare);
+                }
+            }
+            break;
+        }
+        }
+        targets &= checkMask;
+        if (pinned & squareBB(from)) {
+            targets &= lineBB(king, from);
+        }
+        mask.destinations[from] |= targets;
+    }
+
+    for (bool kingSide : { true, false }) {
+        if (checkers || !(board.castling & castlingRight(Us, kingSide))) {
+            continue;
+        }
+        CastlingSquares castle = castlingSquares<Us, Rules>(board, king, kingSide);
+        if ((occ & castle.empty) || (danger & castle.path)) {
+            continue;
+        }
+        if constexpr (Rules::anyCastlingFiles) {
+            // the rook may have been all that kept a slider on the back rank off the king's destination
+            Bitboard after = (occ ^ squareBB(king) ^ squareBB(castle.rook)) | squareBB(castle.kingTo) | squareBB(castle.rookTo);
+            if (board.attackersTo(castle.kingTo, after) & enemy) {
+                continue;
+            }
+        }
+        mask.destinations[king] |= squareBB(castle.target);
+    }
+}
+
+template <typename Rules>
+static void generateLegalMaskAs(const BoardState& board, LegalMask& mask) {
+    if (board.turn == Piece::Color::WHITE) {
+        generateLegalMaskFor<Piece::Color::WHITE, Rules>(board, mask);
+    }
+    else {
+        generateLegalMaskFor<Piece::Color::BLACK, Rules>(board, mask);
+    }
+}
+
+void generateLegalMask(const BoardState& board, LegalMask& mask) {
+    if (board.variant == Variant::CHESS960) {
+        generateLegalMaskAs<Chess960Rules>(board, mask);
+    }
+    else {
+        generateLegalMaskAs<StandardRules>(board, mask);
+    }
+}
+
+uint64_t perft(BoardState& board, int depth) {
+    MoveList list;
+    generateLegalMoves(board, list);
+    if (depth <= 1) {
+        return depth == 1 ? list.size : 1;
+    }
+
+    uint64_t nodes = 0;
+    for (EngineMove move : list) {
+        UndoInfo undo;
+        board.makeMove(move, undo);
+        nodes += perft(board, depth - 1);
+        board.unmakeMove(undo);
+    }
+    return nodes;
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "AttackTables.h"
+#include "ChessObjects.h"
+#include "Evaluation.h"
+#include "Rules.h"
+
+// Compact value-type board used by the engine. Squares are indexed row * 8 + col using the
+// same (row, col) layout as Board, so square 0 is black's queen-side rook corner and white moves
+// towards row 0.
+
+constexpr int colorIndex(Piece::Color color) { return static_cast<int>(color); }
+inline Piece::Color opposite(Piece::Color color) {
+	return color == Piece::Color::WHITE ? Piece::Color::BLACK : Piece::Color::WHITE;
+}
+
+// piece codes stored in BoardState::squares: the PieceType plus 8 for black, 0 is an empty square
+const uint8_t NO_PIECE = 0;
+inline uint8_t pieceCode(Piece::Color color, Piece::PieceType::Type type) {
+	return static_cast<uint8_t>(type | (color == Piece::Color::BLACK ? 8 : 0));
+}
+inline Piece::PieceType::Type typeOf(uint8_t code) { return static_cast<Piece::PieceType::Type>(code & 7); }
+inline Piece::Color colorOf(uint8_t code) { return (code & 8) ? Piece::Color::BLACK : Piece::Color::WHITE; }
+
+// castling right bits
+const uint8_t WHITE_KCASTLE = 1;
+const uint8_t WHITE_QCASTLE = 2;
+const uint8_t BLACK_KCASTLE = 4;
+const uint8_t BLACK_QCASTLE = 8;
+inline uint8_t castlingRight(Piece::Color color, bool kingSide) {
+	return color == Piece::Color::WHITE ? (kingSide ? WHITE_KCASTLE : WHITE_QCASTLE) : (kingSide ? BLACK_KCASTLE : BLACK_QCASTLE);
+}
+// index of a right in BoardState::castlingRooks
+inline int castlingIndex(uint8_t right) { return std::countr_zero(right); }
+
+// squares a pawn of the given colour on sq attacks; the rest of the attack tables are in AttackTables.h
+constexpr Bitboard pawnAttacks(Piece::Color color, int sq) { return ATTACKS.pawn[colorIndex(color)][sq]; }
+
+// 16 bit move: from (6 bits), to (6 bits) and a 4 bit flag holding the MoveType, or the
+// promotion piece for PROM moves
+struct EngineMove {
+	uint16_t data;
+
+	EngineMove() : data(0) {}
+	EngineMove(int from, int to, PositionType::MoveType mtype, Piece::PieceType::Type promotion = Piece::PieceType::QUEEN);
+
+	int from() const { return data & 63; }
+	int to() const { return (data >> 6) & 63; }
+	PositionType::MoveType mtype() const;
+	Piece::PieceType::Type promotion() const;
+	bool isNull() const { return data == 0; }
+
+	bool operator==(const EngineMove& other) const { return data == other.data; }
+	bool operator!=(const EngineMove& other) const { return data != other.data; }
+
+	Move toMove() const;
+	std::string toUci() const;
+};
+
+struct MoveList {
+	EngineMove moves[256];
+	int size = 0;
+
+	void push(EngineMove move) { moves[size++] = move; }
+	EngineMove* begin() { return moves; }
+	EngineMove* end() { return moves + size; }
+	const EngineMove* begin() const { return moves; }
+	const EngineMove* end() const { return moves + size; }
+};
+
+// everything makeMove overwrites that unmakeMove cannot recompute
+struct UndoInfo {
+	EngineMove move;
+	uint8_t captured;
+	uint8_t castling;
+	int8_t epSquare;
+	uint8_t checks[2];
+	uint64_t key;
+};
+
+// CAPTURES also holds queen promotions so quiescence sees them; EVASIONS is only for a side in
+// check and holds king moves plus the captures and blocks of a single checker
+enum class GenType { CAPTURES, QUIETS, EVASIONS, ALL };
+
+struct BoardState {
+	std::array<uint8_t, 64> squares;
+	Bitboard byType[7];   // indexed by Piece::PieceType::Type, byType[PIECE] holds every occupied square
+	Bitboard byColor[2];
+	Piece::Color turn;
+	uint8_t castling;
+	int8_t epSquare;      // square a pawn can capture onto en passant, -1 if none
+	Variant variant;
+	int8_t castlingRooks[4];  // starting square of the rook each castling right moves, by castlingIndex
+	uint8_t checks[2];    // checks each colour has given, counted only in three-check
+	uint64_t key;         // Zobrist hash, kept up to date by makeMove
+	EvalAccumulator eval; // kept up to date by putPiece and removePiece
+
+	BoardState();
+
+	// chess960Index is the Scharnagl number of a Chess960 start, 518 being the standard one
+	static BoardState startPosition(Variant variant = Variant::STANDARD, int chess960Index = 518);
+	// castling rights come from the pieces that have not moved: in Chess960 from the unmoved rooks on
+	// either side of an unmoved king, otherwise only from those on the standard squares
+	static BoardState fromState(const std::vector<std::vector<Piece*>>& state, Piece::Color turn, const Move* lastMove, Variant variant = Variant::STANDARD);
+	// castling rights may be KQkq, taking the outermost rook on that side, or the rooks' files as in
+	// Shredder-FEN; three-check counts follow the en passant square as checks remaining, 3+3, or
+	// given, +0+0
+	static bool fromFen(const std::string& fen, BoardState& out, Variant variant = Variant::STANDARD);
+	std::string toFen() const;
+
+	Bitboard occupied() const { return byType[Piece::PieceType::PIECE]; }
+	Bitboard pieces(Piece::Color color, Piece::PieceType::Type type) const { return byColor[colorIndex(color)] & byType[type]; }
+	int kingSquare(Piece::Color color) const { return lsb(pieces(color, Piece::PieceType::KING)); }
+
+	uint64_t computeKey() const;
+
+	bool isSquareAttacked(int sq, Piece::Color by) const;
+	// pieces of both colours attacking sq given an occupancy, used by exchange evaluation
+	Bitboard attackersTo(int sq, Bitboard occupied) const;
+	bool inCheck() const { return isSquareAttacked(kingSquare(turn), opposite(turn)); }
+	// enemy pieces giving check to the side to move
+	Bitboard checkers() const { return attackersTo(kingSquare(turn), occupied()) & byColor[colorIndex(opposite(turn))]; }
+
+	// neither side can ever win under the position's variant: bare kings, a single minor piece, or
+	// bishops all on one square colour; in three-check only bare kings, since any other piece can
+	// still give check, and never in King of the Hill, where either king can walk to the hill
+	bool insufficientMaterial() const;
+
+	// the side to move has lost by its variant's own rule: the other king stands on the hill, or
+	// the other side has given its last check
+	bool variantLoss() const {
+		switch (variant) {
+		case Variant::KING_OF_THE_HILL: return lostUnder<KingOfTheHillRules>();
+		case Variant::THREE_CHECK: return lostUnder<ThreeCheckRules>();
+		default: return false;
+		}
+	}
+
+	void makeMove(EngineMove move, UndoInfo& undo);
+	void unmakeMove(const UndoInfo& undo);
+
+	// whether a move taken from another position (table move, killer) can be played here, ignoring pins and checks
+	bool isPseudoLegal(EngineMove move) const;
+
+	// find the legal move matching a (row, col) Move, returns a null move if there is none.
+	// promotion is only used when the Move does not record its own promotion piece
+	EngineMove findMove(const Move& move, Piece::PieceType::Type promotion = Piece::PieceType::QUEEN) const;
+
+	void putPiece(uint8_t code, int sq);
+	void removePiece(int sq);
+	void movePiece(int from, int to);
+
+private:
+	void updateEpSquare(int sq);
+
+	template <typename Rules>
+	bool lostUnder() const {
+		Piece::Color them = opposite(turn);
+		if constexpr (Rules::hill != 0) {
+			return pieces(them, Piece::PieceType::KING) & Rules::hill;
+		}
+		else {
+			return checks[colorIndex(them)] >= Rules::checksToWin;
+		}
+	}
+};
+
+// pseudo-legal generation; callers must reject moves that leave their own king in check
+void generateMoves(const BoardState& board, GenType type, MoveList& list);
+void generateLegalMoves(BoardState& board, MoveList& list);
+
+// every legal move of a position as a destination bitboard per origin square, so a move is legal
+// exactly when its bit is set. A promotion is legal to every piece whenever the pawn's move is,
+// so the four pieces share one bit. Castling is the king's move to castlingTarget.
+struct alignas(64) LegalMask {
+	Bitboard destinations[64];
+
+	// squares holding a piece that can move
+	Bitboard origins() const {
+		Bitboard origins = 0;
+		for (int sq = 0; sq < 64; sq++) {
+			origins |= destinations[sq] ? squareBB(sq) : 0;
+		}
+		return origins;
+	}
+	bool empty() const { return origins() == 0; }
+};
+
+// legal moves straight from the bitboards using check and pin masks, without building a move list
+// or trying each move on the board
+void generateLegalMask(const BoardState& board, LegalMask& mask);
+
+uint64_t perft(BoardState& board, int depth);
@@ -1,5 +1,10 @@
 #include "ChessObjects.h"
+#include <algorithm>
 #include <iostream>
+#include <sstream>
+#include "AttackTables.h"
+#include "BoardState.h"
+#include "Log.h"
 
 
 // Constructor definition for Position
@@ -36,24 +41,29 @@ std::size_t positionType_hash::operator()(const PositionType& ptype) const {
     return posHash ^ (mtypeHash << 1);
 }
 
-Move::Move(Position from, Position to): m_from(from), m_to(to) {}
+Move::Move(Position from, Position to, Piece::PieceType::Type promotion): m_from(from), m_to(to), m_promotion(promotion) {}
 
-Board::Board(int rows, int cols) : m_rows(rows), m_cols(cols) {
+Board::Board(int rows, int cols, Arena* arena) : m_rows(rows), m_cols(cols), m_arena(arena) {
+    if (m_arena == nullptr) {
+        m_ownArena = std::make_unique<Arena>();
+        m_arena = m_ownArena.get();
+    }
     m_state.resize(rows, std::vector<Piece*>(cols, nullptr));
 	initializeBoard();
 }
 
-Board::~Board() {
-    // Cleanup code (delete dynamically allocated pieces, etc.)
-    for (int i = 0; i < m_rows; ++i) {
-        for (int j = 0; j < m_cols; ++j) {
-            if (m_state[i][j] != nullptr) {
-                delete m_state[i][j];
-            }
-        }
+Board::Board(const BoardState& position, Arena* arena) : m_rows(8), m_cols(8), m_arena(arena) {
+    if (m_arena == nullptr) {
+        m_ownArena = std::make_unique<Arena>();
+        m_arena = m_ownArena.get();
     }
+    m_state.resize(m_rows, std::vector<Piece*>(m_cols, nullptr));
+    loadPosition(position);
 }
 
+// pieces, captured ones included, are freed with the arena
+Board::~Board() = default;
+
 std::vector<std::vector<Piece*>> Board::getState() {
     return m_state;
 }
@@ -69,94 +79,142 @@ void Board::setPiece(Piece* piece, const Position& pos) {
     m_state[pos.row][pos.col] = piece;
 }
 
-void Board::createPiece(Piece::PieceType::Type ptype, Piece::Color pcolor, Position& pos) {
+Piece* Board::newPiece(Piece::PieceType::Type ptype, Piece::Color pcolor) {
+    for (size_t i = 0; i < m_spare.size(); i++) {
+        Piece* piece = m_spare[i];
+        if (piece->getType().type == ptype && piece->getColor() == pcolor) {
+            m_spare[i] = m_spare.back();
+            m_spare.pop_back();
+            piece->setMoved(false);
+            return piece;
+        }
+    }
+    Piece* piece;
     switch (ptype) {
+    case Piece::PieceType::PAWN:   piece = m_arena->create<Pawn>(pcolor); break;
+    case Piece::PieceType::KING:   piece = m_arena->create<King>(pcolor); break;
+    case Piece::PieceType::QUEEN:  piece = m_arena->create<Queen>(pcolor); break;
+    case Piece::PieceType::ROOK:   piece = m_arena->create<Rook>(pcolor); break;
+    case Piece::PieceType::KNIGHT: piece = m_arena->create<Knight>(pcolor); break;
+    case Piece::PieceType::BISHOP: piece = m_arena->create<Bishop>(pcolor); break;
+    default:                       return nullptr;
+    }
+    m_pieces.push_back(piece);
+    return piece;
+}
 
-    case Piece::PieceType::QUEEN:
-        m_state[pos.row][pos.col] = new Queen(pcolor);
-        m_state[pos.row][pos.col]->setPos(pos);
-        break;
-
-    case Piece::PieceType::BISHOP:
-        m_state[pos.row][pos.col] = new Bishop(pcolor);
-        m_state[pos.row][pos.col]->setPos(pos);
-        break;
+void Board::createPiece(Piece::PieceType::Type ptype, Piece::Color pcolor, Position& pos) {
+    // only promotions create pieces mid-game
+    if (ptype == Piece::PieceType::PAWN || ptype == Piece::PieceType::KING || ptype == Piece::PieceType::PIECE) {
+        LOG_ERROR("board", "invalid piece type " << ptype << " to create");
+        return;
+    }
+    m_state[pos.row][pos.col] = newPiece(ptype, pcolor);
+    m_state[pos.row][pos.col]->setPos(pos);
+}
 
-    case Piece::PieceType::KNIGHT:
-        m_state[pos.row][pos.col] = new Knight(pcolor);
-        m_state[pos.row][pos.col]->setPos(pos);
-        break;
+void Board::loadPosition(const BoardState& position) {
+    for (std::vector<Piece*>& row : m_state) {
+        std::fill(row.begin(), row.end(), nullptr);
+    }
+    m_spare = m_pieces;
+    for (int sq = 0; sq < 64; sq++) {
+        uint8_t code = position.squares[sq];
+        if (code == NO_PIECE) {
+            continue;
+        }
+        Piece::PieceType::Type type = typeOf(code);
+        Piece::Color color = colorOf(code);
+        int row = rowOf(sq), col = colOf(sq);
+        bool white = color == Piece::Color::WHITE;
 
-    case Piece::PieceType::ROOK:
-        m_state[pos.row][pos.col] = new Rook(pcolor);
-        m_state[pos.row][pos.col]->setPos(pos);
-        break;
+        // only pawns, kings and rooks care whether they have moved
+        bool moved = false;
+        if (type == Piece::PieceType::PAWN) {
+            moved = row != (white ? 6 : 1);
+        }
+        else if (type == Piece::PieceType::KING) {
+            moved = !(position.castling & (white ? WHITE_KCASTLE | WHITE_QCASTLE : BLACK_KCASTLE | BLACK_QCASTLE));
+        }
+        else if (type == Piece::PieceType::ROOK) {
+            uint8_t right = 0;
+            for (bool kingSide : { true, false }) {
+                uint8_t side = castlingRight(color, kingSide);
+                if (position.castlingRooks[castlingIndex(side)] == sq) right |= side;
+            }
+            moved = !(position.castling & right);
+        }
 
-    default:
-        std::cerr << "Invalid piece type!" << std::endl;
-        break;
+        Piece* piece = newPiece(type, color);
+        piece->setPos(Position(row, col));
+        piece->setMoved(moved);
+        m_state[row][col] = piece;
     }
-
 }
 
 void Board::initializeBoard() {// Place pawns for both colors
     for (int col = 0; col < m_cols; ++col) {
-        m_state[1][col] = new Pawn(Pawn::Color::BLACK);
-        m_state[6][col] = new Pawn(Piece::Color::WHITE);
-    }
-
-    m_state[0][0] = new Rook(Rook::Color::BLACK);
-    m_state[0][1] = new Knight(Knight::Color::BLACK);
-    m_state[0][2] = new Bishop(Bishop::Color::BLACK);
-    m_state[0][3] = new Queen(Queen::Color::BLACK);
-    m_state[0][4] = new King(King::Color::BLACK);
-    m_state[0][5] = new Bishop(Bishop::Color::BLACK);
-    m_state[0][6] = new Knight(Knight::Color::BLACK);
-    m_state[0][7] = new Rook(Rook::Color::BLACK);
-
-    m_state[7][0] = new Rook(Rook::Color::WHITE);
-    m_state[7][1] = new Knight(Knight::Color::WHITE);
-    m_state[7][2] = new Bishop(Bishop::Color::WHITE);
-    m_state[7][3] = new Queen(Queen::Color::WHITE);
-    m_state[7][4] = new King(King::Color::WHITE);
-    m_state[7][5] = new Bishop(Bishop::Color::WHITE);
-    m_state[7][6] = new Knight(Knight::Color::WHITE);
-    m_state[7][7] = new Rook(Rook::Color::WHITE);
+        m_state[1][col] = m_arena->create<Pawn>(Pawn::Color::BLACK);
+        m_state[6][col] = m_arena->create<Pawn>(Piece::Color::WHITE);
+    }
+
+    m_state[0][0] = m_arena->create<Rook>(Rook::Color::BLACK);
+    m_state[0][1] = m_arena->create<Knight>(Knight::Color::BLACK);
+    m_state[0][2] = m_arena->create<Bishop>(Bishop::Color::BLACK);
+    m_state[0][3] = m_arena->create<Queen>(Queen::Color::BLACK);
+    m_state[0][4] = m_arena->create<King>(King::Color::BLACK);
+    m_state[0][5] = m_arena->create<Bishop>(Bishop::Color::BLACK);
+    m_state[0][6] = m_arena->create<Knight>(Knight::Color::BLACK);
+    m_state[0][7] = m_arena->create<Rook>(Rook::Color::BLACK);
+
+    m_state[7][0] = m_arena->create<Rook>(Rook::Color::WHITE);
+    m_state[7][1] = m_arena->create<Knight>(Knight::Color::WHITE);
+    m_state[7][2] = m_arena->create<Bishop>(Bishop::Color::WHITE);
+    m_state[7][3] = m_arena->create<Queen>(Queen::Color::WHITE);
+    m_state[7][4] = m_arena->create<King>(King::Color::WHITE);
+    m_state[7][5] = m_arena->create<Bishop>(Bishop::Color::WHITE);
+    m_state[7][6] = m_arena->create<Knight>(Knight::Color::WHITE);
+    m_state[7][7] = m_arena->create<Rook>(Rook::Color::WHITE);
 
     for (int row = 0; row < m_rows; row++) {
         for (int col = 0; col < m_cols; col++) {
             if (m_state[row][col]) {
                 m_state[row][col]->setPos(Position(row, col));
+                m_pieces.push_back(m_state[row][col]);
             }
         }
     }
 }
 
 void Board::printBoard() const {
+    // built first and written at once, so a board costs one write rather than a flush per row
+    std::ostringstream out;
+
     // Print the column numbers at the top
-    std::cout << "   ";
+    out << "   ";
     for (int j = 0; j < m_cols; ++j) {
-        std::cout << j << "  ";
+        out << j << "  ";
     }
-    std::cout << std::endl;
+    out << '\n';
 
     // Print each row with the row number on the left side
     for (int i = 0; i < m_rows; ++i) {
         // Print the row number
-        std::cout << i << "  ";
+        out << i << "  ";
 
         for (int j = 0; j < m_cols; ++j) {
             if (m_state[i][j]) {
-                std::cout << (m_state[i][j]->getColor() == Piece::Color::WHITE ? "W" : "B")
+                out << (m_state[i][j]->getColor() == Piece::Color::WHITE ? "W" : "B")
                     << m_state[i][j]->getIdent() << " ";
             }
             else {
-                std::cout << " . ";  // Empty square
+                out << " . ";  // Empty square
             }
         }
-        std::cout << std::endl;
+        out << '\n';
     }
-    std::cout << " " << std::endl;
+    out << " \n";
+    std::cout << out.str();
 }
 
 // Constructor definition for Piece Types
@@ -187,125 +245,50 @@ std::string Piece::getIdent() const {
     return m_ident;
 }
 
-bool Piece::isDefended(const std::vector<std::vector<Piece*>>& state) {
-    Position position = getPos();
-
-    // check for defending pawns
-    int pawn_direction = (m_color == Piece::Color::WHITE) ? 1 : -1;  // White moves up, black moves down
-    for (int offset : {-1, 1}) {
-        int r = position.row + pawn_direction;
-        int c = position.col + offset;
-        if (r < 0 || r >= 8 || c < 0 || c >= 8) {
-            continue; // Skip invalid positions off the board
-        }
-        Piece* pieceAtNewPos = state[r][c];
-        if (pieceAtNewPos == nullptr) {
-            continue;
-        }
-        if (state[r][c]->getType().type == Piece::PieceType::PAWN &&
-            state[r][c]->getColor() == m_color) {
-            return true;
+Piece* firstPieceOnRay(const std::vector<std::vector<Piece*>>& state, int sq, int dir) {
+    Bitboard ray = ATTACKS.rays[dir][sq];
+    while (ray) {
+        int next = nearestOnRay(dir, ray);
+        ray ^= squareBB(next);
+        if (Piece* piece = state[rowOf(next)][colOf(next)]) {
+            return piece;
         }
     }
-    // check for defending knights
-    std::vector<std::pair<int, int>> knight_directions = {
-        {-2, 1}, {-2, -1}, {2, -1}, {2, 1},  // Vertical L-shapes
-        {-1, 2}, {-1, -2}, {1, -2}, {1, 2}   // Horizontal L-shapes
-    };
-
-    for (const auto& direction : knight_directions) {
-        int r = position.row + direction.first;
-        int c = position.col + direction.second;
+    return nullptr;
+}
 
-        // Check if the position is off the board
-        if (r < 0 || r >= 8 || c < 0 || c >= 8) {
-            continue; // Skip invalid positions off the board
-        }
+bool Piece::isDefended(const std::vector<std::vector<Piece*>>& state) {
+    int sq = squareOf(m_pos.row, m_pos.col);
+    auto isFriendly = [&](Piece* piece, Piece::PieceType::Type type) {
+        return piece != nullptr && piece->getColor() == m_color && piece->getType().type == type;
+    };
 
-        // Check the piece at the new position
-        Piece* pieceAtNewPos = state[r][c];
-        if (pieceAtNewPos == nullptr) {
-            continue;
+    // defending pawns stand where a pawn of the other colour on this square would attack
+    Piece::Color other = (m_color == Piece::Color::WHITE) ? Piece::Color::BLACK : Piece::Color::WHITE;
+    for (Bitboard pawns = ATTACKS.pawn[static_cast<int>(other)][sq]; pawns;) {
+        int from = popLsb(pawns);
+        if (isFriendly(state[rowOf(from)][colOf(from)], Piece::PieceType::PAWN)) {
+            return true;
         }
-        if (pieceAtNewPos->getType().type == Piece::PieceType::KNIGHT &&
-            pieceAtNewPos->getColor() == m_color) {
-            return true; 
+    }
+    for (Bitboard knights = knightAttacks(sq); knights;) {
+        int from = popLsb(knights);
+        if (isFriendly(state[rowOf(from)][colOf(from)], Piece::PieceType::KNIGHT)) {
+            return true;
         }
     }
 
-    // check for attacking diagonal
-    std::vector<std::pair<int, int>> diagonal_directions = {
-        {-1, -1}, {-1, 1}, {1, -1}, {1, 1}
-    };
-
-    for (const auto& direction : diagonal_directions) {
-        int r = position.row;
-        int c = position.col;
-
-        while (true) {
-            r += direction.first;
-            c += direction.second;
-
-            // Check if the position is off the board
-            if (r < 0 || r >= 8 || c < 0 || c >= 8) {
-                break; // Outside the board, stop moving
-            }
-
-            // Check the piece at the new position
-            Piece* pieceAtNewPos = state[r][c];
-            if (pieceAtNewPos == nullptr) {
-                continue;
-            }
-            if (pieceAtNewPos->getColor() == m_color) {
-                if (pieceAtNewPos->getType().type == Piece::PieceType::BISHOP ||
-                    pieceAtNewPos->getType().type == Piece::PieceType::QUEEN) {
-                    return true;
-                }
-                else {
-                    break;
-                }
-            }
-            else {
-                break; // Friendly piece blocks the move
-            }
+    // only the nearest piece along each line can defend
+    for (int dir : DIAGONAL_RAYS) {
+        Piece* piece = firstPieceOnRay(state, sq, dir);
+        if (isFriendly(piece, Piece::PieceType::BISHOP) || isFriendly(piece, Piece::PieceType::QUEEN)) {
+            return true;
         }
     }
-
-    // check for attacking files and ranks
-    std::vector<std::pair<int, int>> rankfile_directions = {
-        {-1, 0}, {1, 0}, {0, 1}, {0, -1}
-    };
-
-    for (const auto& direction : rankfile_directions) {
-        int r = position.row;
-        int c = position.col;
-
-        while (true) {
-            r += direction.first;
-            c += direction.second;
-
-            // Check if the position is off the board
-            if (r < 0 || r >= 8 || c < 0 || c >= 8) {
-                break; // Outside the board, stop moving
-            }
-
-            // Check the piece at the new position
-            Piece* pieceAtNewPos = state[r][c];
-            if (pieceAtNewPos == nullptr) {
-                continue;
-            }
-            if (pieceAtNewPos->getColor() == m_color) {
-                if (pieceAtNewPos->getType().type == Piece::PieceType::ROOK ||
-                    pieceAtNewPos->getType().type == Piece::PieceType::QUEEN) {
-                    return true;
-                }
-                else {
-                    break;
-                }
-            }
-            else {
-                break; // Friendly piece blocks the move
-            }
+    for (int dir : ORTHOGONAL_RAYS) {
+        Piece* piece = firstPieceOnRay(state, sq, dir);
+        if (isFriendly(piece, Piece::PieceType::ROOK) || isFriendly(piece, Piece::PieceType::QUEEN)) {
+            return true;
         }
     }
 
@@ -347,55 +330,43 @@ std::unordered_set<PositionType, positionType_hash> Pawn::lineOfAttack(const std
 }
 
 std::unordered_set<PositionType, positionType_hash> Pawn::validMoves(const std::vector<std::vector<Piece*>>& state, Move* lastMove) {
+    return m_color == Color::WHITE ? validMovesFor<Color::WHITE>(state, lastMove) : validMovesFor<Color::BLACK>(state, lastMove);
+}
+
+template <Piece::Color Us>
+std::unordered_set<PositionType, positionType_hash> Pawn::validMovesFor(const std::vector<std::vector<Piece*>>& state, Move* lastMove) {
 
     std::unordered_set<PositionType, positionType_hash> positions;
 
-    int direction = (m_color == Piece::Color::WHITE) ? -1 : 1;  // White moves up, black moves down
+    constexpr int direction = (Us == Color::WHITE) ? -1 : 1;  // White moves up, black moves down
+    constexpr int promotionRow = (Us == Color::WHITE) ? 0 : 7;
 
     int row = m_pos.row + direction;
     int col = m_pos.col;
 
-    if (row >= 1 && row < 7 && col >= 0 && col < 8 && state[row][col] == nullptr) {
-        positions.insert({ { row, col }, PositionType::MoveType::STND });
-    } else if (row == 0 && m_color == Piece::Color::WHITE && col >= 0 && col < 8 && state[row][col] == nullptr) {
-        positions.insert({ { row, col }, PositionType::MoveType::PROM });
-    } else if (row == 7 && m_color == Piece::Color::BLACK && col >= 0 && col < 8 && state[row][col] == nullptr) {
-        positions.insert({ { row, col }, PositionType::MoveType::PROM });
-    }
+    if (row >= 0 && row < 8 && state[row][col] == nullptr) {
+        positions.insert({ { row, col }, row == promotionRow ? PositionType::MoveType::PROM : PositionType::MoveType::STND });
 
-    if (!m_moved) {
+        // double move if pawn has not moved, only through an empty square
         row = m_pos.row + 2 * direction;
-        if (row >= 0 && row < 8 && col >= 0 && col < 8 && state[row][col] == nullptr) {
-            positions.insert({ { row, col }, PositionType::MoveType::STND }); // double move if pawn has not moved
+        if (!m_moved && row >= 0 && row < 8 && state[row][col] == nullptr) {
+            positions.insert({ { row, col }, PositionType::MoveType::STND });
         }
     }
 
-    std::vector<std::pair<int, int>> captureDirs = { {-1, -1}, {-1, 1} }; // White captures up-left and up-right
-    if (m_color == Piece::Color::BLACK) {
-        captureDirs = { {1, -1}, {1, 1} }; // Black captures down-left and down-right
-    }
-    for (const auto& dir : captureDirs) {
-        row = m_pos.row + dir.first;
-        col = m_pos.col + dir.second;
-        if (row >= 0 && row < 8 && col >= 0 && col < 8) {
-            Piece* pieceAtNewPos = state[row][col];
-            if (pieceAtNewPos != nullptr && pieceAtNewPos->getColor() != m_color) {
-                if (row == 0 && m_color == Piece::Color::WHITE) {
-                    positions.insert({ { row, col }, PositionType::MoveType::PROM });
-                }
-                else if (row == 7 && m_color == Piece::Color::BLACK) {
-                    positions.insert({ { row, col }, PositionType::MoveType::PROM });
-                }
-                else {
-                    positions.insert({ { row, col }, PositionType::MoveType::CAPT }); // diagonal captures
-                }
-            }
+    for (Bitboard captures = ATTACKS.pawn[static_cast<int>(Us)][squareOf(m_pos.row, m_pos.col)]; captures;) {
+        int to = popLsb(captures);
+        row = rowOf(to);
+        col = colOf(to);
+        Piece* pieceAtNewPos = state[row][col];
+        if (pieceAtNewPos != nullptr && pieceAtNewPos->getColor() != Us) {
+            positions.insert({ { row, col }, row == promotionRow ? PositionType::MoveType::PROM : PositionType::MoveType::CAPT }); // diagonal captures
         }
     }
     // en passant
     if (lastMove && 
         state[lastMove->m_to.row][lastMove->m_to.col]->getType().type == Piece::PieceType::PAWN &&
-        state[lastMove->m_to.row][lastMove->m_to.col]->getColor() != m_color &&
+        state[lastMove->m_to.row][lastMove->m_to.col]->getColor() != Us &&
         abs(lastMove->m_from.row - lastMove->m_to.row) == 2 &&
         lastMove->m_to.row == m_pos.row) {
         if ((m_pos.col + 1 == lastMove->m_to.col) || (m_pos.col - 1 == lastMove->m_to.col)) {
@@ -433,6 +404,11 @@ std::unordered_set<PositionType, positionType_hash> King::validMoves(const std::
 
     std::vector<std::vector<int>> squaresAttacked(8, std::vector<int>(8));
 
+    // attacks and defenders are found with the king off the board, so a square or piece behind it
+    // on a slider's line counts as covered and the king cannot step back along the line
+    std::vector<std::vector<Piece*>> withoutKing = state;
+    withoutKing[m_pos.row][m_pos.col] = nullptr;
+
     for (int i = 0; i < 8; i++) {
         for (int j = 0; j < 8; j++) {
             Piece* piece = state[i][j];
@@ -447,8 +423,16 @@ std::unordered_set<PositionType, positionType_hash> King::validMoves(const std::
                         {{pos.row + 1, pos.col - 1}, PositionType::MoveType::STND}, {{pos.row + 1, pos.col + 1}, PositionType::MoveType::STND}
                     };
                 }
+                else if (piece->getType().type == Piece::PieceType::PAWN) {
+                    // a pawn attacks its diagonals whether or not anything stands there, and never the squares ahead
+                    int sq = squareOf(piece->getPos().row, piece->getPos().col);
+                    for (Bitboard attacks = ATTACKS.pawn[static_cast<int>(piece->getColor())][sq]; attacks;) {
+                        int attacked = popLsb(attacks);
+                        attackedPositions.insert({ { rowOf(attacked), colOf(attacked) }, PositionType::MoveType::CAPT });
+                    }
+                }
                 else {
-                    attackedPositions = piece->validMoves(state, lastMove);
+                    attackedPositions = piece->validMoves(withoutKing, lastMove);
                 }
                 
                 for (const auto& pos : attackedPositions) {
@@ -471,7 +455,7 @@ std::unordered_set<PositionType, positionType_hash> King::validMoves(const std::
                 positions.insert({ { r, c }, PositionType::MoveType::STND }); // Empty square, valid move or enemy piece
             }
             else if (pieceAtNewPos->getColor() != m_color) {
-                if (!pieceAtNewPos->isDefended(state)) {
+                if (!pieceAtNewPos->isDefended(withoutKing)) {
                     positions.insert({ { r, c }, PositionType::MoveType::CAPT });
                 }
                 // can only capture if the piece is not defended
@@ -479,27 +463,43 @@ std::unordered_set<PositionType, positionType_hash> King::validMoves(const std::
         }
     }
     if (!m_moved && !squaresAttacked[m_pos.row][m_pos.col]) {
-        // Check if castling is possible (with White King-side and Queen-side Rooks)
-
-        if (state[m_pos.row][7] && 
-            !state[m_pos.row][7]->hasMoved() &&
-            state[m_pos.row][5] == nullptr && 
-            state[m_pos.row][6] == nullptr &&
-            !squaresAttacked[m_pos.row][5] &&
-            !squaresAttacked[m_pos.row][6]) {
-
-            positions.insert({ { m_pos.row, m_pos.col + 2 }, PositionType::MoveType::KCASTLE });  // King-side castling
-        }
-
-        if (state[m_pos.row][0] &&
-            !state[m_pos.row][0]->hasMoved() &&
-            state[m_pos.row][1] == nullptr &&
-            state[m_pos.row][2] == nullptr &&
-            state[m_pos.row][3] == nullptr &&
-            !squaresAttacked[m_pos.row][2] &&
-            !squaresAttacked[m_pos.row][3]) {
-
-            positions.insert({ { m_pos.row, m_pos.col - 2 }, PositionType::MoveType::QCASTLE });  // Queen-side castling
+        // Castling with the unmoved rook on either side, wherever the two started (Chess960): king and
+        // rook end on the files they reach in standard chess, every square either crosses must be
+        // empty but for the two of them, and none the king crosses may be attacked.
+        int row = m_pos.row;
+        for (int side : { 1, -1 }) {
+            int rookCol = -1;
+            for (int col = m_pos.col + side; col >= 0 && col < 8; col += side) {
+                Piece* piece = state[row][col];
+                if (piece != nullptr && piece->getColor() == m_color && piece->getType().type == PieceType::ROOK && !piece->hasMoved()) {
+                    rookCol = col;
+                }
+            }
+            if (rookCol < 0) {
+                continue;
+            }
+            int kingTo = side > 0 ? 6 : 2;
+            int rookTo = side > 0 ? 5 : 3;
+            bool clear = true;
+            for (int col = std::min({ m_pos.col, kingTo, rookCol, rookTo }); col <= std::max({ m_pos.col, kingTo, rookCol, rookTo }); col++) {
+                bool kingCrosses = col >= std::min(m_pos.col, kingTo) && col <= std::max(m_pos.col, kingTo);
+                if ((col != m_pos.col && col != rookCol && state[row][col] != nullptr) || (kingCrosses && squaresAttacked[row][col])) {
+                    clear = false;
+                }
+            }
+            // the rook itself may have been keeping a rook or queen on the back rank off the king's destination
+            for (int col = kingTo + side; clear && col >= 0 && col < 8; col += side) {
+                Piece* piece = state[row][col];
+                if (piece != nullptr && col != rookCol && col != m_pos.col) {
+                    PieceType::Type type = piece->getType().type;
+                    clear = piece->getColor() == m_color || (type != PieceType::ROOK && type != PieceType::QUEEN);
+                    break;
+                }
+            }
+            if (clear) {
+                int target = castlingTarget(squareOf(row, m_pos.col), squareOf(row, rookCol));
+                positions.insert({ { rowOf(target), colOf(target) }, side > 0 ? PositionType::MoveType::KCASTLE : PositionType::MoveType::QCASTLE });
+            }
         }
     }
     return positions;
@@ -756,20 +756,9 @@ std::unordered_set<PositionType, positionType_hash> Knight::validMoves(const std
 
     std::unordered_set<PositionType, positionType_hash> positions;
 
-    std::vector<std::pair<int, int>> directions = {
-        {-2, 1}, {-2, -1}, {2, -1}, {2, 1},  // Vertical L-shapes
-        {-1, 2}, {-1, -2}, {1, -2}, {1, 2}   // Horizontal L-shapes
-    };
-
-    // Check each of the 8 possible moves
-    for (const auto& direction : directions) {
-        int r = m_pos.row + direction.first;
-        int c = m_pos.col + direction.second;
-
-        // Check if the position is off the board
-        if (r < 0 || r >= 8 || c < 0 || c >= 8) {
-            continue; // Skip invalid positions off the board
-        }
+    for (Bitboard targets = knightAttacks(squareOf(m_pos.row, m_pos.col)); targets;) {
+        int to = popLsb(targets);
+        int r = rowOf(to), c = colOf(to);
 
         // Check the piece at the new position
         Piece* pieceAtNewPos = state[r][c];
@@ -779,10 +768,7 @@ std::unordered_set<PositionType, positionType_hash> Knight::validMoves(const std
         else if (pieceAtNewPos->getColor() != m_color) {
             positions.insert({ { r, c }, PositionType::MoveType::CAPT }); // Opponent piece, valid capture
         }
-        else if (pieceAtNewPos->getColor() == m_color) {
-            // Friendly piece blocks the move
-            continue;
-        }
+        // Friendly piece blocks the move
     }
 
     return positions;
@@ -1,11 +1,17 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <utility>
 #include <queue> 
 #include <deque>
 #include <functional>
+#include <unordered_map>
 #include <unordered_set>
+#include <memory_resource>
+#include "Arena.h"
+#include "Evaluation.h"
+#include "Rules.h"
 
 struct pair_hash {
 	template <typename T1, typename T2>
@@ -52,14 +58,10 @@ struct positionType_hash {
 	size_t operator()(const PositionType& posType) const;
 };
 
-struct Move {
-	Position m_from;   // Position from where the piece is moving
-	Position m_to;     // Position where the piece is moving to
-
-	Move(Position from, Position to);
-	~Move() = default;
-};
-
+struct Move;
+struct BoardState;
+struct GameSnapshot;
+struct LegalMask;
 
 class Piece {
 
@@ -103,6 +105,17 @@ protected:
 	bool m_defended;
 };
 
+struct Move {
+	Position m_from;   // Position from where the piece is moving
+	Position m_to;     // Position where the piece is moving to
+	Piece::PieceType::Type m_promotion;  // piece a pawn became, PIECE for every other move
+
+	Move(Position from, Position to, Piece::PieceType::Type promotion = Piece::PieceType::PIECE);
+	~Move() = default;
+};
+
+using MoveHistory = std::pmr::deque<Move>;
+
 class Pawn : public Piece {
 
 public:
@@ -111,6 +124,11 @@ public:
 	std::unordered_set<PositionType, positionType_hash> validMoves(const std::vector<std::vector<Piece*>>& state, Move* lastMove) override;
 	std::unordered_set<PositionType, positionType_hash> lineOfAttack(const std::vector<std::vector<Piece*>>& state, const Position& kingPos) override;
 	PieceType getType() const override;
+
+private:
+	// one copy per colour so direction and promotion row are constants
+	template <Color Us>
+	std::unordered_set<PositionType, positionType_hash> validMovesFor(const std::vector<std::vector<Piece*>>& state, Move* lastMove);
 };
 
 class King : public Piece {
@@ -169,12 +187,25 @@ public:
 
 class Board {
 public:
-	Board(int rows, int cols);
+	// pieces are allocated from the arena and freed with it; without one the board keeps its own
+	Board(int rows, int cols, Arena* arena = nullptr);
+
+	// an 8x8 board set up as the given position instead of the starting one
+	Board(const BoardState& position, Arena* arena);
 
 	virtual ~Board();
 
 	void createPiece(Piece::PieceType::Type ptype, Piece::Color pcolor, Position& pos);
 
+	// a piece allocated from the board's arena but not placed on it, nullptr for PIECE; after a
+	// loadPosition, pieces of the same kind are handed out again before the arena grows
+	Piece* newPiece(Piece::PieceType::Type ptype, Piece::Color pcolor);
+
+	// replaces every piece with the position's; hasMoved is recovered from castling rights and pawn
+	// ranks. Every piece the board has handed out is reused, captured ones included, so anything
+	// still holding one must let go of it
+	void loadPosition(const BoardState& position);
+
 	Piece* getPiece(const Position& pos);
 
 	void setPiece(Piece* piece, const Position& pos);
@@ -189,38 +220,96 @@ public:
 
 private:
 	int m_rows, m_cols;
+	std::unique_ptr<Arena> m_ownArena;
+	Arena* m_arena;
 	std::vector<std::vector<Piece*>> m_state;
+	std::vector<Piece*> m_pieces;  // every piece handed out, since the arena never frees one
+	std::vector<Piece*> m_spare;   // those free for newPiece to hand out again
 
 };
 
+// the legal moves of a side, the destinations of each origin square that has any
+using LegalMoves = std::unordered_map<Position, std::unordered_set<PositionType, positionType_hash>, position_hash>;
+
+// the first piece met walking from square sq along ray dir (AttackTables.h numbering), nullptr at the edge
+Piece* firstPieceOnRay(const std::vector<std::vector<Piece*>>& state, int sq, int dir);
+
 class Player {
 public:
 
+	// a plain value: copies share the captured pieces, which belong to the game's arena
 	Player();
 	~Player();
+	Player(const Player&) = default;
+	Player& operator=(const Player&) = default;
 	Piece::Color getColor();
 	void setColor(Piece::Color color);
 	Position getKingpos();
 	void setKingpos(Position& pos);
 	std::vector<Piece*> attackingPieces(const std::vector<std::vector<Piece*>>& state);
-	std::unordered_map<Position, std::unordered_set<PositionType, positionType_hash>, position_hash> legalMoves(const std::vector<std::vector<Piece*>>& state, Move* lastMove);
-	std::vector<Piece*> capturedPieces;
+	LegalMoves legalMoves(const std::vector<std::vector<Piece*>>& state, Move* lastMove);
+	// one piece's share of legalMoves, given the number of pieces checking the king and checkBlocks of them
+	std::unordered_set<PositionType, positionType_hash> legalMovesFrom(const std::vector<std::vector<Piece*>>& state, Piece* piece, Move* lastMove,
+		size_t checkers, const std::unordered_set<std::pair<int, int>, pair_hash>& blocks);
+	// the squares a move must land on to answer a single check, empty otherwise
+	std::unordered_set<std::pair<int, int>, pair_hash> checkBlocks(const std::vector<std::vector<Piece*>>& state, const std::vector<Piece*>& checkers);
+	// the legal moves as a destination bitboard per origin square, generated from the bitboards
+	// rather than the pieces, for consumers that want a fixed-size form
+	void legalMoves(const std::vector<std::vector<Piece*>>& state, Move* lastMove, LegalMask& mask);
+	std::vector<Piece*> capturedPieces;  // owned by the game's arena
 	bool putsKingInCheck(const std::vector<std::vector<Piece*>>& state, const Move& move);
 
+	// bot players pick their own moves with the search engine; a depth of 0 is a human player
+	void setBot(int maxDepth, int moveTimeMs);
+	bool isBot() const;
+	int getBotDepth() const;
+	int getBotTime() const;
+
 
 private:
 	Piece::Color m_color;
 	std::queue<Move*> moveQueue;
 	Position m_kingPos;
+	int m_botDepth;
+	int m_botTimeMs;
 };
 
 class Game {
 public:
+	// the last two are King of the Hill and Three-check wins for the side that just moved
+	enum class Status { ONGOING, CHECKMATE, STALEMATE, REPETITION, FIFTY_MOVES, INSUFFICIENT_MATERIAL, HILL_REACHED, THIRD_CHECK };
+
+	// how legalMoves keeps up with the board: regenerate every piece's moves on each call, recompute
+	// only the origin squares the moves since the last call could have affected, or do both and log
+	// any difference, returning the full result. New games take CHESS_MOVE_UPDATES, incremental by default
+	enum class MoveUpdates { FULL, INCREMENTAL, VERIFY };
+
 	Game(Player& player_1, Player& player_2);
 
+	// a new game continuing from a snapshot of another; the two share nothing. Games in other
+	// variants start from a snapshot of the variant's start position
+	explicit Game(const GameSnapshot& snapshot);
+
 	virtual ~Game() = default;
 
-	void makeMove(Player& currentPlayer, Move& move, PositionType::MoveType mtype, Move* lastMove);
+	// pieces point into the arena, so games are forked through snapshots rather than copied
+	Game(const Game&) = delete;
+	Game& operator=(const Game&) = delete;
+
+	// flat copy of the game's state, for forking, undo and spectators
+	GameSnapshot snapshot();
+
+	// goes back to a snapshot of this game, or jumps to one of any other; the history keeps only
+	// the moves that led to it, or just its last move when they were never played here. The pieces
+	// it replaces are reused, so undoing over and over does not grow the arena
+	void restore(const GameSnapshot& snapshot);
+
+	// moves played since the start, including those before this game was forked
+	size_t getPlies() const;
+
+	// plays the move and hands the turn to the other side; promotion is only prompted for on stdin
+	// when no piece is given
+	void makeMove(Player& currentPlayer, Move& move, PositionType::MoveType mtype, Move* lastMove, Piece::PieceType::Type promotion = Piece::PieceType::PIECE);
 
 	void playGame();
 
@@ -230,11 +319,67 @@ public:
 
 	std::vector<std::vector<Piece*>> getState();
 
+	// material and piece-square score in centipawns for white, updated by makeMove
+	int getEvaluation() const;
+
+	// every move played so far, oldest first; a forked game starts with the last move before the fork
+	const MoveHistory& getHistory() const;
+
+	// the arena holding this game's pieces and history, for anything else that lives as long as the game
+	Arena& getArena();
+
+	// whether the game is over for the side to move, and how
+	Status getStatus(bool hasLegalMoves);
+
+	// plies since the last capture or pawn move
+	int getHalfmoveClock() const;
+
+	// the side to move's legal moves as a destination bitboard per origin square
+	void getLegalMask(LegalMask& mask);
+
+	// the player's legal moves in the current position, kept per colour between calls; valid until
+	// the next move or restore
+	const LegalMoves& legalMoves(Player& player);
+
+	void setMoveUpdates(MoveUpdates updates);
+	MoveUpdates getMoveUpdates() const;
+
+	// the current position has occurred at least twice before with the same side to move
+	bool isThreefoldRepetition() const;
+
 private:
+	// everything restore sets apart from the board
+	void restoreState(const GameSnapshot& snapshot);
+
+	// the board as an engine position under the game's rules
+	BoardState position(Piece::Color turn, const Move* lastMove);
+
+	// one colour's legal moves as last computed, and what has happened on the board since
+	struct MoveCache {
+		LegalMoves moves;
+		uint64_t changed = 0;     // squares whose contents changed, a bitboard
+		int lastTo = -1;          // destination of the last move when computed, for en passant
+		int kingSq = -1;
+		size_t checkers = 0;
+		bool valid = false;
+	};
+
+	// stale for both colours after the squares' contents changed
+	void markChanged(uint64_t squares);
+
+	ArenaPool::Handle m_arena;  // declared first so it outlives everything allocated from it
 	Board m_board;
 	Piece::Color m_turn;
-	std::deque<Move> history; // push_front(), pop_front(), push_back(), pop_back()
+	EvalAccumulator m_eval;
+	int m_halfmoveClock;
+	std::pmr::vector<uint64_t> m_positionKeys;  // key of every position reached, the current one last
+	MoveHistory history; // push_front(), pop_front(), push_back(), pop_back()
+	size_t m_historyBase;  // moves played before the first one in history
 	Player whitePieces;
 	Player blackPieces;
+	MoveCache m_moveCache[2];  // by colour
+	MoveUpdates m_moveUpdates;
+	Variant m_variant;
+	uint8_t m_checks[2];  // checks given by each colour, counted only in three-check
 };
 
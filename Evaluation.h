@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+
+// Material and piece-square scores are kept as running totals that are updated whenever a piece
+// is placed or removed, so evaluating a position never rescans the board. Colours and piece types
+// are passed as the int values of Piece::Color and Piece::PieceType::Type so this header can be
+// used from ChessObjects.h.
+
+using PieceSquareTable = std::array<std::array<std::array<int, 64>, 7>, 2>;  // [color][type][square], material included
+
+extern const PieceSquareTable pstMidgame;
+extern const PieceSquareTable pstEndgame;
+extern const std::array<int, 7> phaseWeights;
+
+const int MAX_PHASE = 24;  // every knight, bishop, rook and queen still on the board
+
+struct EvalAccumulator {
+	int mg[2];
+	int eg[2];
+	int phase;
+
+	EvalAccumulator() { clear(); }
+
+	void clear() {
+		mg[0] = mg[1] = eg[0] = eg[1] = 0;
+		phase = 0;
+	}
+
+	void add(int color, int type, int sq) {
+		mg[color] += pstMidgame[color][type][sq];
+		eg[color] += pstEndgame[color][type][sq];
+		phase += phaseWeights[type];
+	}
+
+	void remove(int color, int type, int sq) {
+		mg[color] -= pstMidgame[color][type][sq];
+		eg[color] -= pstEndgame[color][type][sq];
+		phase -= phaseWeights[type];
+	}
+
+	void move(int color, int type, int from, int to) {
+		mg[color] += pstMidgame[color][type][to] - pstMidgame[color][type][from];
+		eg[color] += pstEndgame[color][type][to] - pstEndgame[color][type][from];
+	}
+
+	// midgame and endgame scores blended by the remaining material, in centipawns for white
+	int score() const {
+		int mgPhase = phase < MAX_PHASE ? phase : MAX_PHASE;
+		return ((mg[0] - mg[1]) * mgPhase + (eg[0] - eg[1]) * (MAX_PHASE - mgPhase)) / MAX_PHASE;
+	}
+};
+
+struct BoardState;
+
+// static evaluation in centipawns from the side to move
+int evaluate(const BoardState& board);
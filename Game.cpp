@@ -0,0 +1,850 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <iostream>
+#include <unordered_map>
+#include "AttackTables.h"
+#include "ChessObjects.h"
+#include "GameSnapshot.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Search.h"
+
+// CHESS_MOVE_UPDATES=full|incremental|verify sets how new games keep their legal moves
+static Game::MoveUpdates moveUpdatesFromEnvironment() {
+    static const Game::MoveUpdates updates = [] {
+        const char* name = std::getenv("CHESS_MOVE_UPDATES");
+        if (name && std::strcmp(name, "full") == 0) {
+            return Game::MoveUpdates::FULL;
+        }
+        if (name && std::strcmp(name, "verify") == 0) {
+            return Game::MoveUpdates::VERIFY;
+        }
+        return Game::MoveUpdates::INCREMENTAL;
+    }();
+    return updates;
+}
+
+Player::Player(): m_color(Piece::Color::WHITE), m_kingPos(Position(0, 0)), m_botDepth(0), m_botTimeMs(0) {}
+
+// captured pieces belong to the game's arena
+Player::~Player() = default;
+
+Piece::Color Player::getColor() {
+    return m_color;
+}
+
+void Player::setColor(Piece::Color color) {
+    m_color = color;
+}
+
+Position Player::getKingpos() {
+    return m_kingPos;
+}
+
+void Player::setKingpos(Position& pos) {
+    m_kingPos = pos;
+}
+
+void Player::setBot(int maxDepth, int moveTimeMs) {
+    m_botDepth = maxDepth;
+    m_botTimeMs = moveTimeMs;
+}
+
+bool Player::isBot() const {
+    return m_botDepth > 0;
+}
+
+int Player::getBotDepth() const {
+    return m_botDepth;
+}
+
+int Player::getBotTime() const {
+    return m_botTimeMs;
+}
+
+std::vector<Piece*> Player::attackingPieces(const std::vector<std::vector<Piece*>>& state) {
+    std::vector<Piece*> piecesAttacking;
+
+    int kingSq = squareOf(m_kingPos.row, m_kingPos.col);
+    auto isEnemy = [&](Piece* piece, Piece::PieceType::Type type) {
+        return piece != nullptr && piece->getColor() != m_color && piece->getType().type == type;
+    };
+
+    // check for attacking pawns, which stand where our own pawn on the king's square would attack
+    for (Bitboard pawns = ATTACKS.pawn[static_cast<int>(m_color)][kingSq]; pawns;) {
+        int from = popLsb(pawns);
+        if (isEnemy(state[rowOf(from)][colOf(from)], Piece::PieceType::PAWN)) {
+            piecesAttacking.push_back(state[rowOf(from)][colOf(from)]);
+        }
+    }
+    // check for attacking knights
+    for (Bitboard knights = knightAttacks(kingSq); knights;) {
+        int from = popLsb(knights);
+        if (isEnemy(state[rowOf(from)][colOf(from)], Piece::PieceType::KNIGHT)) {
+            piecesAttacking.push_back(state[rowOf(from)][colOf(from)]);
+        }
+    }
+
+    // check for attacking diagonals, files and ranks: only the nearest piece on each line can attack
+    for (int dir : DIAGONAL_RAYS) {
+        Piece* piece = firstPieceOnRay(state, kingSq, dir);
+        if (isEnemy(piece, Piece::PieceType::BISHOP) || isEnemy(piece, Piece::PieceType::QUEEN)) {
+            piecesAttacking.push_back(piece);
+        }
+    }
+    for (int dir : ORTHOGONAL_RAYS) {
+        Piece* piece = firstPieceOnRay(state, kingSq, dir);
+        if (isEnemy(piece, Piece::PieceType::ROOK) || isEnemy(piece, Piece::PieceType::QUEEN)) {
+            piecesAttacking.push_back(piece);
+        }
+    }
+
+    return piecesAttacking;
+}
+static size_t countMoves(const LegalMoves& moves) {
+    size_t count = 0;
+    for (const auto& entry : moves) {
+        count += entry.second.size();
+    }
+    return count;
+}
+
+std::unordered_set<std::pair<int, int>, pair_hash> Player::checkBlocks(const std::vector<std::vector<Piece*>>& state, const std::vector<Piece*>& checkers) {
+    std::unordered_set<std::pair<int, int>, pair_hash> blocks;
+    if (checkers.size() == 1) {
+        for (auto& pos : checkers[0]->lineOfAttack(state, getKingpos())) {
+            blocks.insert(pos.pair);
+        }
+    }
+    return blocks;
+}
+
+std::unordered_set<PositionType, positionType_hash> Player::legalMovesFrom(const std::vector<std::vector<Piece*>>& state, Piece* piece, Move* lastMove,
+    size_t checkers, const std::unordered_set<std::pair<int, int>, pair_hash>& blocks) {
+    std::unordered_set<PositionType, positionType_hash> legal;
+    bool king = piece->getType().type == Piece::PieceType::KING;
+    if (checkers > 1 && !king) {
+        return legal;
+    }
+    Position from_pos = piece->getPos();
+    std::unordered_set<PositionType, positionType_hash> pieceMoves = piece->validMoves(state, lastMove);
+    if (checkers > 0 && king) {
+        return pieceMoves;
+    }
+    for (const auto& pos : pieceMoves) {
+        // in check only moves capturing or blocking the checker can help; en passant captures a
+        // checking pawn beside the square it lands on
+        std::pair<int, int> captured = pos.mtype == PositionType::MoveType::ENPASS ? std::make_pair(from_pos.row, pos.pair.second) : pos.pair;
+        if (checkers == 1 && blocks.find(pos.pair) == blocks.end() && blocks.find(captured) == blocks.end()) {
+            continue;
+        }
+        Move move(from_pos, Position(pos.pair.first, pos.pair.second));
+        if (!putsKingInCheck(state, move)) {
+            legal.insert(pos);
+        }
+    }
+    return legal;
+}
+
+LegalMoves Player::legalMoves(const std::vector<std::vector<Piece*>>& state, Move* lastMove) {
+    METRICS_TIMER(Stage::LEGAL_MOVES);
+
+    LegalMoves legalPieceMoves;
+    std::vector<Piece*> piecesAttacking = attackingPieces(state);
+    LOG_DEBUG("moves", "number of attacking pieces: " << piecesAttacking.size());
+    for (size_t i = 0; i < piecesAttacking.size(); i++) {
+        LOG_DEBUG("moves", "piece attacking: " << piecesAttacking[i]->getIdent() << (piecesAttacking[i]->getColor() == Piece::Color::WHITE ? "W" : "B"));
+    }
+
+    std::unordered_set<std::pair<int, int>, pair_hash> blocks = checkBlocks(state, piecesAttacking);
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            Piece* piece = state[i][j];
+            if (piece != nullptr && piece->getColor() == m_color) {
+                std::unordered_set<PositionType, positionType_hash> pieceMoves = legalMovesFrom(state, piece, lastMove, piecesAttacking.size(), blocks);
+                if (!pieceMoves.empty()) {
+                    legalPieceMoves[piece->getPos()] = std::move(pieceMoves);
+                }
+            }
+        }
+    }
+
+    METRICS_ADD(Counter::MOVES_GENERATED, countMoves(legalPieceMoves));
+    return legalPieceMoves;
+}
+
+void Player::legalMoves(const std::vector<std::vector<Piece*>>& state, Move* lastMove, LegalMask& mask) {
+    METRICS_TIMER(Stage::LEGAL_MOVES);
+    generateLegalMask(BoardState::fromState(state, m_color, lastMove), mask);
+}
+
+bool Player::putsKingInCheck(const std::vector<std::vector<Piece*>>& state, const Move& move) {
+    METRICS_TIMER(Stage::PUTS_KING_IN_CHECK);
+
+    // make a copy for running the simulation
+    std::vector<std::vector<Piece*>> modifiedState = state;
+
+    Piece* piece = modifiedState[move.m_from.row][move.m_from.col];
+
+    // simulate move; a pawn moving diagonally onto an empty square captures en passant, which takes
+    // the pawn beside it off the board as well
+    if (piece->getType().type == Piece::PieceType::PAWN && move.m_from.col != move.m_to.col && modifiedState[move.m_to.row][move.m_to.col] == nullptr) {
+        modifiedState[move.m_from.row][move.m_to.col] = nullptr;
+    }
+    modifiedState[move.m_to.row][move.m_to.col] = piece;
+    modifiedState[move.m_from.row][move.m_from.col] = nullptr;
+
+    std::vector<Piece*> piecesAttacking = attackingPieces(modifiedState);
+
+    bool isKingInCheck;
+    if (piecesAttacking.size() > 0) {
+        isKingInCheck = true;
+    }
+    else {
+        isKingInCheck = false;
+    }
+
+    // undo simulation
+    modifiedState[move.m_to.row][move.m_to.col] = nullptr;
+    modifiedState[move.m_from.row][move.m_from.col] = piece;
+
+    return isKingInCheck;
+};
+
+Game::Game(Player& player_1, Player& player_2)
+    : m_arena(ArenaPool::shared().acquire()), m_board(8, 8, m_arena.get()), m_turn(Piece::Color::WHITE), m_halfmoveClock(0),
+    m_positionKeys(m_arena.get()), history(m_arena.get()), m_historyBase(0), m_moveUpdates(moveUpdatesFromEnvironment()),
+    m_variant(Variant::STANDARD), m_checks{} {
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<> dis(0, 1);
+
+    Piece::Color player1Color = (dis(gen) == 0) ? Piece::Color::WHITE : Piece::Color::BLACK;
+    Piece::Color player2Color = (player1Color == Piece::Color::WHITE) ? Piece::Color::BLACK : Piece::Color::WHITE;
+
+    Position player_1_kp = (player1Color == Piece::Color::WHITE) ? Position(7, 4) : Position(0, 4);
+    Position player_2_kp = (player2Color == Piece::Color::WHITE) ? Position(7, 4) : Position(0, 4);
+
+
+    player_1.setColor(player1Color);
+    player_1.setKingpos(player_1_kp);
+    player_2.setColor(player2Color);
+    player_2.setKingpos(player_2_kp);
+
+    // the game plays with its own copies; the callers' players only learn their colours
+    whitePieces = (player1Color == Piece::Color::WHITE) ? player_1 : player_2;
+    blackPieces = (player1Color == Piece::Color::BLACK) ? player_1 : player_2;
+
+    std::vector<std::vector<Piece*>> state = m_board.getState();
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            if (state[i][j] != nullptr) {
+                m_eval.add(static_cast<int>(state[i][j]->getColor()), state[i][j]->getType().type, squareOf(i, j));
+            }
+        }
+    }
+    m_positionKeys.push_back(position(m_turn, nullptr).key);
+
+}
+
+Game::Game(const GameSnapshot& snapshot)
+    : m_arena(ArenaPool::shared().acquire()), m_board(snapshot.position, m_arena.get()), m_turn(snapshot.position.turn),
+    m_halfmoveClock(0), m_positionKeys(m_arena.get()), history(m_arena.get()), m_historyBase(0), m_moveUpdates(moveUpdatesFromEnvironment()),
+    m_variant(snapshot.position.variant), m_checks{} {
+    restoreState(snapshot);
+}
+
+GameSnapshot Game::snapshot() {
+    GameSnapshot snap;
+    Move* lastMove = getLastMove();
+    snap.position = position(m_turn, lastMove);
+    snap.halfmoveClock = m_halfmoveClock;
+    snap.plies = static_cast<uint32_t>(getPlies());
+    snap.lastFrom = lastMove ? static_cast<int8_t>(squareOf(lastMove->m_from.row, lastMove->m_from.col)) : -1;
+    snap.lastTo = lastMove ? static_cast<int8_t>(squareOf(lastMove->m_to.row, lastMove->m_to.col)) : -1;
+    snap.lastPromotion = lastMove ? static_cast<uint8_t>(lastMove->m_promotion) : 0;
+
+    for (Player* player : { &whitePieces, &blackPieces }) {
+        PlayerSnapshot& out = snap.players[static_cast<int>(player->getColor())];
+        out.botDepth = player->getBotDepth();
+        out.botTimeMs = player->getBotTime();
+        out.capturedCount = 0;
+        for (Piece* piece : player->capturedPieces) {
+            if (out.capturedCount < sizeof(out.captured)) {
+                out.captured[out.capturedCount++] = pieceCode(piece->getColor(), piece->getType().type);
+            }
+        }
+    }
+
+    // older positions can no longer repeat
+    size_t count = std::min({ m_positionKeys.size(), static_cast<size_t>(m_halfmoveClock) + 1, static_cast<size_t>(SNAPSHOT_KEYS) });
+    std::copy(m_positionKeys.end() - count, m_positionKeys.end(), snap.keys);
+    snap.keyCount = static_cast<int>(count);
+    return snap;
+}
+
+void Game::restore(const GameSnapshot& snapshot) {
+    // the board takes back every piece, captured ones included, and restoreState rebuilds the
+    // capture lists from the ones it hands out again
+    m_board.loadPosition(snapshot.position);
+    restoreState(snapshot);
+}
+
+void Game::restoreState(const GameSnapshot& snapshot) {
+    m_moveCache[0].valid = m_moveCache[1].valid = false;
+    m_turn = snapshot.position.turn;
+    m_eval = snapshot.position.eval;
+    m_variant = snapshot.position.variant;
+    m_checks[0] = snapshot.position.checks[0];
+    m_checks[1] = snapshot.position.checks[1];
+    m_halfmoveClock = snapshot.halfmoveClock;
+
+    // a snapshot of this game's own line has its ply still in the history and its position at that
+    // ply; the ply count alone would also match snapshots of other games and other lines
+    size_t plies = getPlies();
+    size_t back = plies - snapshot.plies;
+    bool rewind = snapshot.plies > m_historyBase && snapshot.plies <= plies && back < m_positionKeys.size() &&
+        m_positionKeys[m_positionKeys.size() - 1 - back] == snapshot.position.key;
+    if (rewind) {
+        // drop the moves played since, keeping the keys of the line up to the snapshot
+        history.erase(history.begin() + (snapshot.plies - m_historyBase), history.end());
+        m_positionKeys.resize(m_positionKeys.size() - back);
+    }
+    else {
+        m_positionKeys.assign(snapshot.keys, snapshot.keys + snapshot.keyCount);
+        history.clear();
+        m_historyBase = snapshot.plies;
+        if (snapshot.lastFrom >= 0) {
+            history.emplace_back(Position(rowOf(snapshot.lastFrom), colOf(snapshot.lastFrom)), Position(rowOf(snapshot.lastTo), colOf(snapshot.lastTo)),
+                static_cast<Piece::PieceType::Type>(snapshot.lastPromotion));
+            m_historyBase--;
+        }
+    }
+
+    for (Piece::Color color : { Piece::Color::WHITE, Piece::Color::BLACK }) {
+        Player& player = (color == Piece::Color::WHITE) ? whitePieces : blackPieces;
+        const PlayerSnapshot& saved = snapshot.players[static_cast<int>(color)];
+        int kingSq = snapshot.position.kingSquare(color);
+        Position kingPos(rowOf(kingSq), colOf(kingSq));
+        player.setColor(color);
+        player.setKingpos(kingPos);
+        player.setBot(saved.botDepth, saved.botTimeMs);
+        player.capturedPieces.clear();
+        for (int i = 0; i < saved.capturedCount; i++) {
+            player.capturedPieces.push_back(m_board.newPiece(typeOf(saved.captured[i]), colorOf(saved.captured[i])));
+        }
+    }
+}
+
+BoardState Game::position(Piece::Color turn, const Move* lastMove) {
+    BoardState position = BoardState::fromState(m_board.getState(), turn, lastMove, m_variant);
+    if (m_variant == Variant::THREE_CHECK) {
+        position.checks[0] = m_checks[0];
+        position.checks[1] = m_checks[1];
+        position.key = position.computeKey();
+    }
+    return position;
+}
+
+size_t Game::getPlies() const {
+    return m_historyBase + history.size();
+}
+
+std::vector<std::vector<Piece*>> Game::getState() {
+    return m_board.getState();
+}
+
+int Game::getEvaluation() const {
+    return m_eval.score();
+}
+
+const MoveHistory& Game::getHistory() const {
+    return history;
+}
+
+Arena& Game::getArena() {
+    return *m_arena;
+}
+
+int Game::getHalfmoveClock() const {
+    return m_halfmoveClock;
+}
+
+void Game::getLegalMask(LegalMask& mask) {
+    generateLegalMask(position(m_turn, getLastMove()), mask);
+}
+
+// Squares of the colour's pieces whose legal moves can differ once the changed squares' contents
+// have: the changed squares themselves, sliders and knights reaching one, pawns capturing on or
+// pushing onto one, pieces on the ray from the king through one, whose pins may have come or gone,
+// and pawns beside either last move's destination, which decide en passant. The king's moves depend
+// on which squares around it, and those it castles over until it has moved, the enemy attacks or
+// defends, so it is included when a changed square could reach one of those for any enemy piece,
+// or an en passant capture could land on one. Only holds while the king is not in check.
+static Bitboard staleOrigins(const std::vector<std::vector<Piece*>>& state, Piece::Color color, int kingSq, Bitboard changed, Bitboard moveEnds) {
+    Bitboard occupied = 0;
+    Bitboard own[7] = {};
+    for (int sq = 0; sq < 64; sq++) {
+        Piece* piece = state[rowOf(sq)][colOf(sq)];
+        if (piece != nullptr) {
+            occupied |= squareBB(sq);
+            if (piece->getColor() == color) {
+                own[piece->getType().type] |= squareBB(sq);
+            }
+        }
+    }
+    int us = static_cast<int>(color);
+    int forward = color == Piece::Color::WHITE ? -8 : 8;
+    Bitboard diagonal = own[Piece::PieceType::BISHOP] | own[Piece::PieceType::QUEEN];
+    Bitboard straight = own[Piece::PieceType::ROOK] | own[Piece::PieceType::QUEEN];
+
+    Bitboard stale = changed;
+    for (Bitboard squares = changed; squares;) {
+        int sq = popLsb(squares);
+        stale |= (bishopAttacks(sq, occupied) & diagonal) | (rookAttacks(sq, occupied) & straight) | (knightAttacks(sq) & own[Piece::PieceType::KNIGHT]);
+        // pawns capturing on it stand where a pawn of the other colour on it would attack
+        Bitboard pawns = ATTACKS.pawn[1 - us][sq];
+        for (int behind : { sq - forward, sq - 2 * forward }) {
+            if (behind >= 0 && behind < 64) {
+                pawns |= squareBB(behind);
+            }
+        }
+        stale |= pawns & own[Piece::PieceType::PAWN];
+        for (int dir = 0; dir < 8; dir++) {
+            if (ATTACKS.rays[dir][kingSq] & squareBB(sq)) {
+                stale |= ATTACKS.rays[dir][kingSq];
+            }
+        }
+    }
+    for (Bitboard squares = moveEnds; squares;) {
+        stale |= kingAttacks(popLsb(squares)) & own[Piece::PieceType::PAWN];
+    }
+    stale &= ~squareBB(kingSq);
+
+    // an enemy piece reaches a square along a line, by a knight or king step or as a pawn, whose
+    // pushes the king's moves count as attacks too
+    auto reach = [occupied](int sq) {
+        Bitboard squares = squareBB(sq) | queenAttacks(sq, occupied) | knightAttacks(sq) | kingAttacks(sq);
+        for (int step : { -16, 16 }) {
+            if (sq + step >= 0 && sq + step < 64) {
+                squares |= squareBB(sq + step);
+            }
+        }
+        return squares;
+    };
+    Bitboard zone = squareBB(kingSq) | kingAttacks(kingSq);
+    Bitboard castling = 0;
+    Piece* king = state[rowOf(kingSq)][colOf(kingSq)];
+    if (king != nullptr && !king->hasMoved()) {
+        int row = rowOf(kingSq);
+        zone |= squareBB(squareOf(row, 2)) | squareBB(squareOf(row, 3)) | squareBB(squareOf(row, 5)) | squareBB(squareOf(row, 6));
+        castling = Bitboard(0xFF) << (8 * row);
+    }
+    Bitboard zoneReach = castling, nearZone = zone;
+    for (Bitboard squares = zone; squares;) {
+        int sq = popLsb(squares);
+        zoneReach |= reach(sq);
+        nearZone |= kingAttacks(sq);
+    }
+    for (Bitboard squares = nearZone; squares;) {
+        nearZone |= kingAttacks(popLsb(squares));
+    }
+    if ((changed & zoneReach) || (moveEnds & nearZone)) {
+        stale |= squareBB(kingSq);
+    }
+    return stale;
+}
+
+const LegalMoves& Game::legalMoves(Player& player) {
+    MoveCache& cache = m_moveCache[static_cast<int>(player.getColor())];
+    Move* lastMove = getLastMove();
+    int lastTo = lastMove ? squareOf(lastMove->m_to.row, lastMove->m_to.col) : -1;
+    // asked again about the same position
+    if (cache.valid && cache.changed == 0 && cache.lastTo == lastTo && m_moveUpdates == MoveUpdates::INCREMENTAL) {
+        return cache.moves;
+    }
+    std::vector<std::vector<Piece*>> state = getState();
+    Position kingPos = player.getKingpos();
+    int kingSq = squareOf(kingPos.row, kingPos.col);
+    size_t checkers = player.attackingPieces(state).size();
+
+    // a check, or a king that has moved, can change any piece's moves
+    bool updatable = cache.valid && checkers == 0 && cache.checkers == 0 && cache.kingSq == kingSq;
+    LegalMoves incremental;
+    if (updatable && m_moveUpdates != MoveUpdates::FULL) {
+        METRICS_TIMER(Stage::LEGAL_MOVES);
+        Bitboard moveEnds = 0;
+        for (int sq : { cache.lastTo, lastTo }) {
+            if (sq >= 0) {
+                moveEnds |= squareBB(sq);
+            }
+        }
+        // verification keeps the cache as it was until the full result replaces it
+        LegalMoves& moves = m_moveUpdates == MoveUpdates::VERIFY ? (incremental = cache.moves) : cache.moves;
+        std::unordered_set<std::pair<int, int>, pair_hash> noBlocks;
+        for (Bitboard stale = staleOrigins(state, player.getColor(), kingSq, cache.changed, moveEnds); stale;) {
+            int sq = popLsb(stale);
+            Position from(rowOf(sq), colOf(sq));
+            moves.erase(from);
+            Piece* piece = state[from.row][from.col];
+            if (piece != nullptr && piece->getColor() == player.getColor()) {
+                std::unordered_set<PositionType, positionType_hash> pieceMoves = player.legalMovesFrom(state, piece, lastMove, 0, noBlocks);
+                if (!pieceMoves.empty()) {
+                    moves[from] = std::move(pieceMoves);
+                }
+            }
+        }
+    }
+    if (!updatable || m_moveUpdates != MoveUpdates::INCREMENTAL) {
+        cache.moves = player.legalMoves(state, lastMove);
+        if (updatable && m_moveUpdates == MoveUpdates::VERIFY && incremental != cache.moves) {
+            LOG_ERROR("moves", "incremental legal moves differ from regenerated ones after " << getPlies() << " plies, last move "
+                << (lastMove ? lastMove->m_from : Position(-1, -1)) << " -> " << (lastMove ? lastMove->m_to : Position(-1, -1)));
+        }
+    }
+    cache.changed = 0;
+    cache.lastTo = lastTo;
+    cache.kingSq = kingSq;
+    cache.checkers = checkers;
+    cache.valid = true;
+    return cache.moves;
+}
+
+void Game::markChanged(uint64_t squares) {
+    m_moveCache[0].changed |= squares;
+    m_moveCache[1].changed |= squares;
+}
+
+void Game::setMoveUpdates(MoveUpdates updates) {
+    m_moveUpdates = updates;
+}
+
+Game::MoveUpdates Game::getMoveUpdates() const {
+    return m_moveUpdates;
+}
+
+bool Game::isThreefoldRepetition() const {
+    // only positions since the last capture or pawn move can repeat, and only every other one has the same side to move
+    size_t current = m_positionKeys.size() - 1;
+    size_t reversible = std::min<size_t>(m_halfmoveClock, current);
+    int occurrences = 1;
+    for (size_t back = 4; back <= reversible; back += 2) {
+        if (m_positionKeys[current - back] == m_positionKeys[current] && ++occurrences == 3) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Game::Status Game::getStatus(bool hasLegalMoves) {
+    BoardState position = this->position(m_turn, getLastMove());
+    if (position.variantLoss()) {
+        return m_variant == Variant::KING_OF_THE_HILL ? Status::HILL_REACHED : Status::THIRD_CHECK;
+    }
+    if (!hasLegalMoves) {
+        return position.inCheck() ? Status::CHECKMATE : Status::STALEMATE;
+    }
+    if (m_halfmoveClock >= 100) {
+        return Status::FIFTY_MOVES;
+    }
+    if (isThreefoldRepetition()) {
+        return Status::REPETITION;
+    }
+    if (position.insufficientMaterial()) {
+        return Status::INSUFFICIENT_MATERIAL;
+    }
+    return Status::ONGOING;
+}
+
+Move* Game::getLastMove() {
+    if (!history.empty()) {
+        return &history.back();
+    }
+    else {
+        return nullptr;
+    }
+}
+
+void Game::addMoveToHistory(const Move& move) {
+    history.push_back(move);
+}
+
+// request moves from whitePieces or blackPieces
+// push move onto their queue
+// check whos turn it is
+// pop move off player whos turn it is
+// get all their valid moves
+    // to get valid moves check if they are in checkmate
+        // if they are in checkmate (current board state) return no valid moves: game ends
+        // check if they are in check (current board state)
+        // determine if it is double check
+        // if they are in check return only valid moves that can be made while in check
+// if their move is valid, perform the move 
+// push the move onto the move history stack and change the turn to the other player
+// if the move is not valid, pop another move from the queue or prompt another input (start from top)
+// if the move is a king, update king position of respective player
+
+
+// compiled out with LOG_DEBUG, so release builds do not walk the moves for nothing
+void logLegalMoves([[maybe_unused]] const LegalMoves& legalMoves) {
+#if !defined(NDEBUG) || defined(CHESS_DEBUG_LOGGING)
+    for (const auto& entry : legalMoves) {
+        LOG_DEBUG("moves", entry.first << " -> " << [&entry] {
+            std::ostringstream targets;
+            for (const auto& pos : entry.second) {
+                targets << "(" << pos.pair.first << ", " << pos.pair.second << ") ";
+            }
+            return targets.str();
+        }());
+    }
+#endif
+}
+
+void Game::playGame() {
+
+    while (true) {
+
+        // a reference, so the king position makeMove records stays with the game's player
+        Player& currentPlayer = (m_turn == Piece::Color::WHITE) ? whitePieces : blackPieces;
+
+        std::vector<std::vector<Piece*>> gameState = getState();
+        Move* lastMove = getLastMove();
+        const LegalMoves& legalMoves = this->legalMoves(currentPlayer);
+
+
+        logLegalMoves(legalMoves);
+
+        Status status = getStatus(!legalMoves.empty());
+        if (status != Status::ONGOING) {
+            switch (status) {
+            case Status::CHECKMATE:
+                std::cout << "Checkmate! " << (m_turn == Piece::Color::WHITE ? "Black " : "White ") << "wins!" << std::endl;
+                break;
+            case Status::STALEMATE:
+                std::cout << "Stalemate! The game is a draw." << std::endl;
+                break;
+            case Status::REPETITION:
+                std::cout << "Draw by threefold repetition." << std::endl;
+                break;
+            case Status::FIFTY_MOVES:
+                std::cout << "Draw by the fifty-move rule." << std::endl;
+                break;
+            case Status::HILL_REACHED:
+                std::cout << "King of the hill! " << (m_turn == Piece::Color::WHITE ? "Black " : "White ") << "wins!" << std::endl;
+                break;
+            case Status::THIRD_CHECK:
+                std::cout << "Third check! " << (m_turn == Piece::Color::WHITE ? "Black " : "White ") << "wins!" << std::endl;
+                break;
+            default:
+                std::cout << "Draw by insufficient material." << std::endl;
+                break;
+            }
+            break;
+        }
+
+        if (currentPlayer.isBot()) {
+            SearchLimits limits;
+            limits.maxDepth = currentPlayer.getBotDepth();
+            limits.moveTimeMs = currentPlayer.getBotTime();
+
+            // one table serves every bot game in the process
+            static TranspositionTable botTable(16);
+            botTable.newSearch();
+            Searcher searcher(&botTable);
+            static Tablebase tablebases;
+            static bool tablebasesLoaded = tablebases.load("tablebases") > 0;
+            if (tablebasesLoaded) {
+                searcher.setTablebase(&tablebases);
+            }
+            SearchResult result = searcher.search(position(m_turn, lastMove), limits);
+            if (result.bestMove.isNull()) {
+                std::cout << (result.score == 0 ? "Stalemate!" : "Checkmate!") << std::endl;
+                break;
+            }
+            std::cout << (m_turn == Piece::Color::WHITE ? "White" : "Black") << " bot plays " << result.bestMove.toUci()
+                << " (depth " << result.depth << ", score " << result.score << ")" << '\n';
+
+            Move move = result.bestMove.toMove();
+            makeMove(currentPlayer, move, result.bestMove.mtype(), lastMove, result.bestMove.promotion());
+            addMoveToHistory(move);
+            continue;
+        }
+
+        int startRow, startCol, endRow, endCol;
+        m_board.printBoard();
+
+        std::cout << (currentPlayer.getColor() == Piece::Color::WHITE ? "White" : "Black") << " to move" << '\n';
+        std::cout << "Enter the row and column of the piece you want to move (row col): ";
+        std::cin >> startRow >> startCol;
+
+        std::cout << "Enter the row and column for the destination (row col): ";
+        std::cin >> endRow >> endCol;
+
+
+        Position fromPos(startRow, startCol);
+        Position toPos(endRow, endCol);
+
+        auto found = legalMoves.find(fromPos);
+        if (found != legalMoves.end()) {
+            for (const auto& pos : found->second) {
+                if (pos.pair.first == toPos.row && pos.pair.second == toPos.col) {
+                    Move move(fromPos, toPos);
+                    makeMove(currentPlayer, move, pos.mtype, lastMove);
+                    addMoveToHistory(move);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void Game::makeMove(Player& currentPlayer, Move& move, PositionType::MoveType mtype, Move* lastMove, Piece::PieceType::Type promotion) {
+    METRICS_TIMER(Stage::MAKE_MOVE);
+    METRICS_ADD(Counter::MOVES_PLAYED, 1);
+    // could make this a switch of switches instead of if elses I am thinking
+    Piece::Color pcolor = currentPlayer.getColor();
+    Piece* piece = m_board.getPiece(move.m_from);
+    bool irreversible = mtype == PositionType::MoveType::CAPT || mtype == PositionType::MoveType::ENPASS ||
+        mtype == PositionType::MoveType::PROM || piece->getType().type == Piece::PieceType::PAWN;
+    m_board.removePiece(move.m_from);
+
+    // keep the evaluation totals in step with the board
+    int color = static_cast<int>(pcolor);
+    int from = squareOf(move.m_from.row, move.m_from.col);
+    int to = squareOf(move.m_to.row, move.m_to.col);
+    bool castles = mtype == PositionType::MoveType::KCASTLE || mtype == PositionType::MoveType::QCASTLE;
+    if (mtype != PositionType::MoveType::PROM && !castles) {
+        m_eval.move(color, piece->getType().type, from, to);
+    }
+
+    if (mtype == PositionType::MoveType::STND) {
+        m_board.setPiece(piece, move.m_to);
+        piece->setPos(move.m_to);
+        if (!piece->hasMoved()) {
+            piece->setMoved(true);
+        }
+        if (piece->getType().type == Piece::PieceType::KING) {
+            currentPlayer.setKingpos(move.m_to);
+        }
+    }
+
+    Bitboard castled = 0;
+    if (castles) {
+        // the rook is the one the king was written as taking, as in Chess960, or else the one in the
+        // corner; the two end on the files they reach in standard chess
+        int row = move.m_from.row;
+        bool kingSide = mtype == PositionType::MoveType::KCASTLE;
+        Position rookFrom = m_board.getPiece(move.m_to) != nullptr ? move.m_to : Position(row, kingSide ? 7 : 0);
+        Position kingTo(row, kingSide ? 6 : 2);
+        Position rookTo(row, kingSide ? 5 : 3);
+        Piece* rook = m_board.getPiece(rookFrom);
+
+        m_board.removePiece(rookFrom);
+        m_board.setPiece(piece, kingTo);
+        m_board.setPiece(rook, rookTo);
+
+        piece->setPos(kingTo);
+        piece->setMoved(true);
+
+        rook->setPos(rookTo);
+        rook->setMoved(true);
+        m_eval.move(color, Piece::PieceType::KING, from, squareOf(kingTo.row, kingTo.col));
+        m_eval.move(color, Piece::PieceType::ROOK, squareOf(rookFrom.row, rookFrom.col), squareOf(rookTo.row, rookTo.col));
+
+        currentPlayer.setKingpos(kingTo);
+        castled = squareBB(squareOf(kingTo.row, kingTo.col)) | squareBB(squareOf(rookFrom.row, rookFrom.col)) | squareBB(squareOf(rookTo.row, rookTo.col));
+        // recorded as the king's move, which is what the history and en passant read back
+        move.m_to = kingTo;
+    }
+    else if (mtype == PositionType::MoveType::ENPASS) {
+        m_board.setPiece(piece, move.m_to);
+        piece->setPos(move.m_to);
+        int direction = (pcolor == Piece::Color::WHITE) ? 1 : -1;
+        Piece* capturedPiece = m_board.getPiece(Position(move.m_to.row + direction, move.m_to.col));
+        currentPlayer.capturedPieces.push_back(capturedPiece);
+        m_board.removePiece(Position(move.m_to.row + direction, move.m_to.col));
+        m_eval.remove(1 - color, Piece::PieceType::PAWN, squareOf(move.m_to.row + direction, move.m_to.col));
+        piece->setMoved(true);
+
+    }
+    else if (mtype == PositionType::MoveType::PROM) {
+        Piece* capturedPiece = m_board.getPiece(move.m_to);
+        if (capturedPiece != nullptr) {
+            currentPlayer.capturedPieces.push_back(capturedPiece);
+        }
+        m_eval.remove(color, Piece::PieceType::PAWN, from);
+
+        int promSelection;
+        switch (promotion) {
+        case Piece::PieceType::QUEEN: promSelection = 0; break;
+        case Piece::PieceType::KNIGHT: promSelection = 1; break;
+        case Piece::PieceType::BISHOP: promSelection = 2; break;
+        case Piece::PieceType::ROOK: promSelection = 3; break;
+        default:
+            std::cout << "Select which piece to promote to { 0: Queen, 1: Knight, 2: Bishop, 3: Rook }" << std::endl;
+            std::cin >> promSelection;
+            break;
+        }
+
+        switch (promSelection) {
+
+        case 0:
+            m_board.createPiece(Piece::PieceType::QUEEN, pcolor, move.m_to);
+            break;
+
+        case 1:
+            m_board.createPiece(Piece::PieceType::KNIGHT, pcolor, move.m_to);
+            break;
+
+        case 2:
+            m_board.createPiece(Piece::PieceType::BISHOP, pcolor, move.m_to);
+            break;
+
+        case 3:
+            m_board.createPiece(Piece::PieceType::ROOK, pcolor, move.m_to);
+            break;
+
+        default:
+            LOG_ERROR("game", "invalid promotion piece " << promSelection);
+            break;
+        }
+
+        Piece* promoted = m_board.getPiece(move.m_to);
+        if (promoted != capturedPiece) {
+            if (capturedPiece != nullptr) {
+                m_eval.remove(1 - color, capturedPiece->getType().type, to);
+            }
+            m_eval.add(color, promoted->getType().type, to);
+            move.m_promotion = promoted->getType().type;  // recorded so the history can be replayed
+        }
+    } 
+    else if (mtype == PositionType::MoveType::CAPT){
+        Piece* capturedPiece = m_board.getPiece(move.m_to);
+        currentPlayer.capturedPieces.push_back(capturedPiece);
+        m_eval.remove(1 - color, capturedPiece->getType().type, to);
+        m_board.setPiece(piece, move.m_to);
+        piece->setPos(move.m_to);
+        if (!piece->hasMoved()) {
+            piece->setMoved(true);
+        }
+        if (piece->getType().type == Piece::PieceType::KING) {
+            currentPlayer.setKingpos(move.m_to);
+        }
+    }
+
+    Bitboard changed = squareBB(from) | squareBB(to) | castled;
+    if (mtype == PositionType::MoveType::ENPASS) {
+        changed |= squareBB(squareOf(move.m_from.row, move.m_to.col));
+    }
+    markChanged(changed);
+
+    m_halfmoveClock = irreversible ? 0 : m_halfmoveClock + 1;
+    if (m_variant == Variant::THREE_CHECK && position(opposite(pcolor), &move).inCheck()) {
+        m_checks[color]++;
+    }
+    m_positionKeys.push_back(position(opposite(pcolor), &move).key);
+    m_turn = opposite(pcolor);
+}
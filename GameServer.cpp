@@ -0,0 +1,323 @@
+#include "GameServer.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "Log.h"
+#include "Metrics.h"
+
+
+// how long a poll waits before checking for stop
+static const int POLL_TIMEOUT_MS = 50;
+
+// the squares and promotion piece of a move in UCI notation, e7e8q; false if it is malformed
+static bool parseUci(const std::string& uci, int& from, int& to, Piece::PieceType::Type& promotion) {
+    if (uci.size() < 4 || uci[0] < 'a' || uci[0] > 'h' || uci[1] < '1' || uci[1] > '8' || uci[2] < 'a' || uci[2] > 'h' || uci[3] < '1' || uci[3] > '8') {
+        return false;
+    }
+    promotion = Piece::PieceType::PIECE;
+    if (uci.size() > 4) {
+        switch (uci[4]) {
+        case 'q': promotion = Piece::PieceType::QUEEN; break;
+        case 'r': promotion = Piece::PieceType::ROOK; break;
+        case 'b': promotion = Piece::PieceType::BISHOP; break;
+        case 'n': promotion = Piece::PieceType::KNIGHT; break;
+        default: return false;
+        }
+    }
+    // row 0 is the eighth rank
+    from = squareOf('8' - uci[1], uci[0] - 'a');
+    to = squareOf('8' - uci[3], uci[2] - 'a');
+    return true;
+}
+
+// the position's legal move with those squares, a queen for a promotion without a piece; null if
+// there is none
+static EngineMove legalMove(const BoardState& position, int from, int to, Piece::PieceType::Type promotion) {
+    return position.findMove(Move(Position(rowOf(from), colOf(from)), Position(rowOf(to), colOf(to)), promotion));
+}
+
+// the same for squares the game's legal mask already allows, which only needs the move's type
+// from the pseudo-legal moves rather than another legality test
+static EngineMove maskedMove(const BoardState& position, int from, int to, Piece::PieceType::Type promotion) {
+    if (promotion == Piece::PieceType::PIECE) {
+        promotion = Piece::PieceType::QUEEN;
+    }
+    MoveList list;
+    generateMoves(position, GenType::ALL, list);
+    for (EngineMove move : list) {
+        if (move.from() == from && move.to() == to && (move.mtype() != PositionType::MoveType::PROM || move.promotion() == promotion)) {
+            return move;
+        }
+    }
+    return EngineMove();
+}
+
+GameServer::GameServer(int clockMs) : m_pass(0), m_clockMs(clockMs), m_listener(-1), m_port(0), m_quit(false), m_random(std::random_device()()) {}
+
+GameServer::~GameServer() {
+    stop();
+}
+
+bool GameServer::start(uint16_t port) {
+    m_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listener < 0) {
+        LOG_ERROR("server", "socket: " << std::strerror(errno));
+        return false;
+    }
+    int yes = 1;
+    ::setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    socklen_t length = sizeof(address);
+    if (::bind(m_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(m_listener, SOMAXCONN) < 0 ||
+        ::getsockname(m_listener, reinterpret_cast<sockaddr*>(&address), &length) < 0) {
+        LOG_ERROR("server", "cannot listen on port " << port << ": " << std::strerror(errno));
+        ::close(m_listener);
+        m_listener = -1;
+        return false;
+    }
+    ::fcntl(m_listener, F_SETFL, O_NONBLOCK);
+    m_port = ntohs(address.sin_port);
+    m_quit = false;
+    m_thread = std::thread(&GameServer::run, this);
+    LOG_INFO("server", "listening on 127.0.0.1:" << m_port);
+    return true;
+}
+
+void GameServer::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_quit = true;
+    m_thread.join();
+    for (Connection& connection : m_connections) {
+        close(connection);
+    }
+    m_connections.clear();
+    ::close(m_listener);
+    m_listener = -1;
+}
+
+void GameServer::run() {
+    std::vector<pollfd> polled;
+    while (!m_quit) {
+        polled.clear();
+        polled.push_back({ m_listener, POLLIN, 0 });
+        for (const Connection& connection : m_connections) {
+            polled.push_back({ connection.fd, static_cast<short>(POLLIN | (connection.out.empty() ? 0 : POLLOUT)), 0 });
+        }
+        if (::poll(polled.data(), polled.size(), POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+
+        // connections are only added after the pass, so polled[i + 1] stays connection i
+        size_t count = m_connections.size();
+        for (size_t i = 0; i < count; i++) {
+            if ((polled[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) && !receive(m_connections[i])) {
+                close(m_connections[i]);
+            }
+        }
+        serve();
+        for (Connection& connection : m_connections) {
+            if (connection.fd >= 0 && !connection.out.empty() && !send(connection)) {
+                close(connection);
+            }
+        }
+        m_connections.erase(std::remove_if(m_connections.begin(), m_connections.end(), [](const Connection& c) { return c.fd < 0; }), m_connections.end());
+
+        if (polled[0].revents & POLLIN) {
+            int fd;
+            while ((fd = ::accept(m_listener, nullptr, nullptr)) >= 0) {
+                int yes = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                ::fcntl(fd, F_SETFL, O_NONBLOCK);
+                m_connections.push_back({ fd, {}, {}, {} });
+            }
+        }
+    }
+}
+
+bool GameServer::receive(Connection& connection) {
+    char buffer[4096];
+    ssize_t received;
+    {
+        METRICS_TIMER(Stage::NET_RECEIVE);
+        received = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+    }
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        return false;
+    }
+    if (received < 0) {
+        return true;
+    }
+    METRICS_ADD(Counter::BYTES_RECEIVED, static_cast<uint64_t>(received));
+    connection.in.append(buffer, static_cast<size_t>(received));
+    return true;
+}
+
+bool GameServer::send(Connection& connection) {
+    ssize_t sent;
+    {
+        METRICS_TIMER(Stage::NET_SEND);
+        sent = ::send(connection.fd, connection.out.data(), connection.out.size(), MSG_NOSIGNAL);
+    }
+    if (sent < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    METRICS_ADD(Counter::BYTES_SENT, static_cast<uint64_t>(sent));
+    connection.out.erase(0, static_cast<size_t>(sent));
+    return true;
+}
+
+void GameServer::serve() {
+    m_pass++;
+    m_touched.resize(m_store.capacity(), 0);
+    m_requests.clear();
+    m_batch.clear();
+    for (size_t i = 0; i < m_connections.size(); i++) {
+        Connection& connection = m_connections[i];
+        if (connection.fd < 0) {
+            continue;
+        }
+        size_t start = 0, end;
+        while ((end = connection.in.find('\n', start)) != std::string::npos) {
+            METRICS_ADD(Counter::MESSAGES_RECEIVED, 1);
+            collect(i, connection.in.substr(start, end - start));
+            start = end + 1;
+        }
+        connection.in.erase(0, start);
+    }
+
+    if (m_batch.size()) {
+        m_batch.validate(m_store);
+    }
+    for (const Request& request : m_requests) {
+        int legal = request.batched == NOT_BATCHED ? -1 : m_batch.results()[request.batched];
+        handle(m_connections[request.connection], request.line, legal);
+    }
+}
+
+// a game's first move of the pass joins the batch, checked against the masks as they stood when the
+// pass began, unless an end request for the game came first; later ones see the game as the
+// earlier requests leave it
+void GameServer::collect(size_t connection, const std::string& line) {
+    Request request{ connection, line, NOT_BATCHED };
+    char command = line.empty() ? '\0' : line[0];
+    if ((command == 'M' || command == 'E') && line.size() > 2) {
+        GameId id = static_cast<GameId>(std::strtoul(line.c_str() + 2, nullptr, 10));
+        const std::vector<GameId>& games = m_connections[connection].games;
+        if (std::find(games.begin(), games.end(), id) != games.end()) {
+            size_t idEnd = line.find(' ', 2);
+            int from, to;
+            Piece::PieceType::Type promotion;
+            if (command == 'M' && m_touched[id] != m_pass && idEnd != std::string::npos && parseUci(line.substr(idEnd + 1), from, to, promotion)) {
+                request.batched = m_batch.size();
+                m_batch.add(id, from, to);
+            }
+            m_touched[id] = m_pass;
+        }
+    }
+    m_requests.push_back(std::move(request));
+}
+
+void GameServer::handle(Connection& connection, const std::string& line, int legal) {
+    METRICS_ADD(Counter::MESSAGES_SENT, 1);
+    char command = line.empty() ? '\0' : line[0];
+    if (command == 'N') {
+        Variant variant = Variant::STANDARD;
+        char name[32];
+        int start = -1;
+        if (line.size() > 2 && (std::sscanf(line.c_str() + 2, "%31s %d", name, &start) < 1 || !variantFromName(name, variant))) {
+            connection.out += "ERR\n";
+            return;
+        }
+        if (start < 0) {
+            start = static_cast<int>(m_random() % 960);
+        }
+        GameId id = m_store.create(BoardState::startPosition(variant, start), m_clockMs);
+        connection.games.push_back(id);
+        connection.out += "G " + std::to_string(id) + "\n";
+        return;
+    }
+    if (command == 'S') {
+        const ValidationStats& batches = m_batch.total();
+        connection.out += "S " + std::to_string(m_store.size()) + " " + std::to_string(memoryBytes()) + " " + std::to_string(batches.batches) +
+            " " + std::to_string(batches.moves) + " " + std::to_string(batches.nanos) + "\n";
+        return;
+    }
+
+    // the rest name one of the connection's own games
+    size_t idEnd = line.find(' ', 2);
+    GameId id = line.size() > 2 ? static_cast<GameId>(std::strtoul(line.c_str() + 2, nullptr, 10)) : 0;
+    auto owned = std::find(connection.games.begin(), connection.games.end(), id);
+    if (owned == connection.games.end()) {
+        connection.out += "ERR\n";
+        return;
+    }
+    if (command == 'E') {
+        m_store.remove(id);
+        connection.games.erase(owned);
+        connection.out += "OK\n";
+    }
+    else if (command == 'L') {
+        const LegalMask& mask = m_store.legalMask(id);
+        char entry[32];
+        connection.out += "L";
+        for (int sq = 0; sq < 64; sq++) {
+            if (mask.destinations[sq]) {
+                std::snprintf(entry, sizeof(entry), " %d:%llx", sq, static_cast<unsigned long long>(mask.destinations[sq]));
+                connection.out += entry;
+            }
+        }
+        connection.out += "\n";
+    }
+    else if (command == 'M' && idEnd != std::string::npos) {
+        // a move the batch found illegal is refused without waking or searching its game
+        int from, to;
+        Piece::PieceType::Type promotion;
+        EngineMove move;
+        if (legal != 0 && parseUci(line.substr(idEnd + 1), from, to, promotion)) {
+            const BoardState& position = m_store.position(id);
+            move = legal > 0 ? maskedMove(position, from, to, promotion) : legalMove(position, from, to, promotion);
+        }
+        if (!move.isNull() && m_store.play(id, move)) {
+            connection.out += "OK " + std::to_string(static_cast<int>(m_store.status(id))) + "\n";
+        }
+        else {
+            connection.out += "ERR\n";
+        }
+    }
+    else {
+        connection.out += "ERR\n";
+    }
+}
+
+void GameServer::close(Connection& connection) {
+    for (GameId id : connection.games) {
+        m_store.remove(id);
+    }
+    connection.games.clear();
+    if (connection.fd >= 0) {
+        ::close(connection.fd);
+        connection.fd = -1;
+    }
+}
+
+size_t GameServer::memoryBytes() const {
+    size_t bytes = m_store.memoryBytes() + m_connections.capacity() * sizeof(Connection);
+    for (const Connection& connection : m_connections) {
+        bytes += connection.in.capacity() + connection.out.capacity() + connection.games.capacity() * sizeof(GameId);
+    }
+    return bytes;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "GameStore.h"
+#include "MoveValidator.h"
+
+// A minimal game server on the loopback interface: one thread polls every connection and owns the
+// GameStore, so requests queue exactly as they would behind a single-threaded game loop. The
+// protocol is one line per request and one per reply:
+//   N [variant [n]]   new game              ->  G <id>, or ERR for an unknown variant; standard by
+//                                               default, names as in Rules.h, and Chess960 from
+//                                               start position n or a random one
+//   M <id> <uci>      play a move           ->  OK <status>, status as GameStore::Status, or ERR
+//   E <id>            end a game            ->  OK
+//   L <id>            legal moves           ->  L followed by <from>:<destinations> for each square
+//                                               with a move, the mask in hex; just L once it is over
+//   S                 store statistics      ->  S <games> <bytes> <batches> <moves> <ns>, the last three
+//                                               the move batches validated so far, the moves in
+//                                               them and the nanoseconds they took
+// Moves are UCI, castling written as the king's move to castlingTarget. Every request that arrives
+// in one poll pass is answered before the next, in order per connection; the pass's moves are
+// first checked together as one MoveBatch, so an illegal one is refused without touching its
+// game. A game's later moves in the same pass, or those after it was ended, are checked one at a
+// time when their turn comes. A connection's games are ended when it closes. POSIX sockets only.
+class GameServer {
+public:
+	// clocks are effectively unlimited unless given; the store is never ticked
+	explicit GameServer(int clockMs = 1 << 30);
+	~GameServer();
+
+	GameServer(const GameServer&) = delete;
+	GameServer& operator=(const GameServer&) = delete;
+
+	// binds 127.0.0.1 on the port, or a free one for 0, and starts serving; false if it cannot bind
+	bool start(uint16_t port = 0);
+	void stop();
+
+	uint16_t port() const { return m_port; }
+
+private:
+	struct Connection {
+		int fd;
+		std::string in;
+		std::string out;
+		std::vector<GameId> games;
+	};
+
+	// a line received in the current pass, and its move's place in m_batch if it has one
+	struct Request {
+		size_t connection;
+		std::string line;
+		size_t batched;
+	};
+	static const size_t NOT_BATCHED = SIZE_MAX;
+
+	void run();
+	bool receive(Connection& connection);
+	bool send(Connection& connection);
+	void serve();
+	void collect(size_t connection, const std::string& line);
+	// legal is the move's batch result, -1 when it was not batched
+	void handle(Connection& connection, const std::string& line, int legal);
+	void close(Connection& connection);
+	size_t memoryBytes() const;
+
+	GameStore m_store;
+	std::vector<Connection> m_connections;
+	std::vector<Request> m_requests;
+	MoveBatch m_batch;
+	std::vector<uint32_t> m_touched;   // by game ID, the last pass with a move or end request for it
+	uint32_t m_pass;
+	int m_clockMs;
+	int m_listener;
+	uint16_t m_port;
+	std::atomic<bool> m_quit;
+	std::thread m_thread;
+	std::minstd_rand m_random;  // Chess960 start positions
+};
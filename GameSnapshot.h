@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include "BoardState.h"
+
+// positions since the last capture or pawn move, the most a fifty-move game can still repeat
+const int SNAPSHOT_KEYS = 101;
+
+struct PlayerSnapshot {
+	int botDepth;
+	int botTimeMs;
+	uint8_t capturedCount;
+	uint8_t captured[16];   // piece codes; a side can only ever take 15
+};
+
+// Everything needed to carry on a game, as one flat value: taking a snapshot is a copy of about a
+// kilobyte, and forking or rewinding from one allocates only the pieces. The move list itself is
+// left out; a fork remembers only the last move, which en passant needs.
+struct GameSnapshot {
+	BoardState position;
+	int halfmoveClock;
+	uint32_t plies;          // moves played since the start
+	int8_t lastFrom;         // squares of the last move, -1 before the first
+	int8_t lastTo;
+	uint8_t lastPromotion;
+	PlayerSnapshot players[2];   // indexed by colour
+	int keyCount;
+	uint64_t keys[SNAPSHOT_KEYS];  // repetition window, oldest first, the current position last
+
+	// a game starting at the position, with two human players and nothing captured
+	static GameSnapshot fromPosition(const BoardState& position) {
+		GameSnapshot snapshot{};
+		snapshot.position = position;
+		snapshot.lastFrom = -1;
+		snapshot.lastTo = -1;
+		snapshot.keyCount = 1;
+		snapshot.keys[0] = position.key;
+		return snapshot;
+	}
+};
+
+static_assert(std::is_trivially_copyable_v<GameSnapshot>, "snapshots are copied as plain bytes");
@@ -0,0 +1,385 @@
+#include "GameStore.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+
+// captures and pawn moves start a new repetition window; a Chess960 castling move lands on its own
+// rook without capturing it
+static bool irreversible(const BoardState& board, EngineMove move) {
+    bool castles = move.mtype() == PositionType::MoveType::KCASTLE || move.mtype() == PositionType::MoveType::QCASTLE;
+    return (board.squares[move.to()] != NO_PIECE && !castles) || typeOf(board.squares[move.from()]) == Piece::PieceType::PAWN;
+}
+
+// an archive record is the packed start position, a uint16 ply count and a byte a ply, unaligned
+static const size_t RECORD_HEADER = sizeof(PackedPosition) + sizeof(uint16_t);
+
+static size_t recordBytes(const uint8_t* record) {
+    uint16_t plies;
+    std::memcpy(&plies, record + sizeof(PackedPosition), sizeof(plies));
+    return RECORD_HEADER + plies;
+}
+
+GameStore::GameStore() {
+    // slot 0 keeps an all-zero mask for free games
+    acquireSlot();
+}
+
+GameId GameStore::create(const BoardState& start, int clockMs, int incrementMs) {
+    GameId id;
+    if (!m_free.empty()) {
+        id = m_free.back();
+        m_free.pop_back();
+    }
+    else {
+        id = static_cast<GameId>(m_status.size());
+        m_status.push_back(Status::FREE);
+        m_turn.push_back(0);
+        m_whiteClock.push_back(0);
+        m_blackClock.push_back(0);
+        m_increment.push_back(0);
+        m_halfmoveClock.push_back(0);
+        m_key.push_back(0);
+        m_changed.push_back(0);
+        m_slot.push_back(0);
+    }
+
+    m_status[id] = Status::ONGOING;
+    m_turn[id] = start.turn == Piece::Color::BLACK;
+    m_whiteClock[id] = clockMs;
+    m_blackClock[id] = clockMs;
+    m_increment[id] = incrementMs;
+    m_halfmoveClock[id] = 0;
+    m_key[id] = start.key;
+    m_changed[id] = 1;
+
+    uint32_t slot = acquireSlot();
+    m_slot[id] = slot;
+    m_starts[slot] = PackedPosition::pack(start);
+    m_lastActive[slot] = m_now;
+    m_positions[slot] = start;
+    m_keys[slot].assign(1, start.key);
+    generateLegalMask(start, m_legal[slot]);
+    return id;
+}
+
+void GameStore::remove(GameId id) {
+    if (m_status[id] == Status::FREE) {
+        return;
+    }
+    // FREE keeps the slot out of every pass until it is reused
+    m_status[id] = Status::FREE;
+    m_changed[id] = 0;
+    if (m_slot[id] & COMPACTED) {
+        m_archiveDead += recordBytes(&m_archive[m_slot[id] & ~COMPACTED]);
+    }
+    else {
+        releaseSlot(m_slot[id]);
+    }
+    m_slot[id] = 0;
+    m_free.push_back(id);
+}
+
+bool GameStore::play(GameId id, EngineMove move, int elapsedMs) {
+    if (m_status[id] != Status::ONGOING) {
+        return false;
+    }
+    // the mask has the origin and destination, the flags only need to fit the position
+    uint32_t slot = wake(id);
+    BoardState& board = m_positions[slot];
+    if (!(m_legal[slot].destinations[move.from()] & squareBB(move.to())) || !board.isPseudoLegal(move)) {
+        return false;
+    }
+
+    bool reset = irreversible(board, move);
+    int32_t& clock = m_turn[id] ? m_blackClock[id] : m_whiteClock[id];
+    clock -= elapsedMs;
+    if (clock <= 0) {
+        m_status[id] = m_turn[id] ? Status::BLACK_FLAGGED : Status::WHITE_FLAGGED;
+        m_changed[id] = 1;
+        m_legal[slot] = LegalMask{};
+        return false;
+    }
+    clock += m_increment[id];
+
+    UndoInfo undo;
+    board.makeMove(move, undo);
+    m_moves[slot].push_back(move);
+    m_turn[id] ^= 1;
+    m_key[id] = board.key;
+    m_halfmoveClock[id] = reset ? 0 : m_halfmoveClock[id] + 1;
+    std::vector<uint64_t>& keys = m_keys[slot];
+    if (reset) {
+        keys.clear();
+    }
+    keys.push_back(board.key);
+    m_changed[id] = 1;
+
+    LegalMask& replies = m_legal[slot];
+    generateLegalMask(board, replies);
+    if (board.variantLoss()) {
+        m_status[id] = board.variant == Variant::KING_OF_THE_HILL ? Status::HILL_REACHED : Status::THIRD_CHECK;
+    }
+    else if (replies.empty()) {
+        m_status[id] = board.inCheck() ? Status::CHECKMATE : Status::STALEMATE;
+    }
+    else if (m_halfmoveClock[id] >= 100) {
+        m_status[id] = Status::FIFTY_MOVES;
+    }
+    else if (std::count(keys.begin(), keys.end(), board.key) >= 3) {
+        m_status[id] = Status::REPETITION;
+    }
+    else if (board.insufficientMaterial()) {
+        m_status[id] = Status::INSUFFICIENT_MATERIAL;
+    }
+    if (m_status[id] != Status::ONGOING) {
+        replies = LegalMask{};
+    }
+    return true;
+}
+
+size_t GameStore::tick(int elapsedMs) {
+    m_now += elapsedMs;
+    size_t n = m_status.size();
+    Status* status = m_status.data();
+    const uint8_t* turn = m_turn.data();
+    int32_t* white = m_whiteClock.data();
+    int32_t* black = m_blackClock.data();
+    const uint16_t* halfmove = m_halfmoveClock.data();
+    uint8_t* changed = m_changed.data();
+
+    // two branch-free passes so each vectorises: every game is charged, only ongoing ones by a nonzero amount
+    for (size_t i = 0; i < n; i++) {
+        int32_t running = status[i] == Status::ONGOING;
+        int32_t blackToMove = turn[i];
+        white[i] -= elapsedMs & -(running & (blackToMove ^ 1));
+        black[i] -= elapsedMs & -(running & blackToMove);
+    }
+
+    uint32_t ended = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t running = status[i] == Status::ONGOING;
+        uint8_t whiteFlagged = running & (white[i] <= 0);
+        uint8_t blackFlagged = running & (black[i] <= 0);
+        uint8_t fifty = running & (halfmove[i] >= 100);
+        uint8_t next = static_cast<uint8_t>(status[i]);
+        next = fifty ? static_cast<uint8_t>(Status::FIFTY_MOVES) : next;
+        next = blackFlagged ? static_cast<uint8_t>(Status::BLACK_FLAGGED) : next;
+        next = whiteFlagged ? static_cast<uint8_t>(Status::WHITE_FLAGGED) : next;
+        uint8_t over = whiteFlagged | blackFlagged | fifty;
+        status[i] = static_cast<Status>(next);
+        changed[i] |= over;
+        ended += over;
+    }
+
+    // rare, so a plain pass: games that just ended stop accepting moves, compacted ones once woken
+    if (ended) {
+        for (size_t i = 0; i < n; i++) {
+            if (changed[i] && status[i] != Status::ONGOING && status[i] != Status::FREE && !(m_slot[i] & COMPACTED)) {
+                m_legal[m_slot[i]] = LegalMask{};
+            }
+        }
+    }
+    return ended;
+}
+
+bool GameStore::compact(GameId id) {
+    if (m_status[id] == Status::FREE || (m_slot[id] & COMPACTED)) {
+        return false;
+    }
+    uint32_t slot = m_slot[id];
+    const PackedPosition& start = m_starts[slot];
+    const std::vector<EngineMove>& moves = m_moves[slot];
+    if (!start.complete() || moves.size() > UINT16_MAX) {
+        return false;
+    }
+    std::vector<uint8_t> record(RECORD_HEADER + moves.size());
+    std::memcpy(record.data(), &start, sizeof(start));
+    uint16_t plies = static_cast<uint16_t>(moves.size());
+    std::memcpy(record.data() + sizeof(start), &plies, sizeof(plies));
+    BoardState board = start.unpack();
+    for (size_t i = 0; i < moves.size(); i++) {
+        // a move the packing misses could not be replayed, so the game stays live
+        if (!packMove(board, moves[i], record[RECORD_HEADER + i])) {
+            return false;
+        }
+        UndoInfo undo;
+        board.makeMove(moves[i], undo);
+    }
+
+    // dead records are dropped once they outweigh the live ones, so the archive stays within twice its contents
+    if (m_archiveDead > m_archive.size() / 2) {
+        repackArchive();
+    }
+    size_t offset = m_archive.size();
+    if (offset + record.size() > COMPACTED) {
+        return false;
+    }
+    m_archive.insert(m_archive.end(), record.begin(), record.end());
+    // the point is to give the memory back, so the lists go rather than waiting for reuse
+    std::vector<EngineMove>().swap(m_moves[slot]);
+    std::vector<uint64_t>().swap(m_keys[slot]);
+    releaseSlot(slot);
+    m_slot[id] = COMPACTED | static_cast<uint32_t>(offset);
+    return true;
+}
+
+void GameStore::repackArchive() {
+    std::vector<uint8_t> archive;
+    archive.reserve(m_archive.size() - m_archiveDead);
+    for (GameId id = 0; id < m_slot.size(); id++) {
+        if (!(m_slot[id] & COMPACTED)) {
+            continue;
+        }
+        const uint8_t* record = &m_archive[m_slot[id] & ~COMPACTED];
+        m_slot[id] = COMPACTED | static_cast<uint32_t>(archive.size());
+        archive.insert(archive.end(), record, record + recordBytes(record));
+    }
+    m_archive.swap(archive);
+    m_archiveDead = 0;
+}
+
+size_t GameStore::compactIdle(int64_t idleMs) {
+    size_t compactedGames = 0;
+    for (GameId id = 0; id < m_status.size(); id++) {
+        if (!(m_slot[id] & COMPACTED) && m_now - m_lastActive[m_slot[id]] >= idleMs && compact(id)) {
+            compactedGames++;
+        }
+    }
+    if (compactedGames) {
+        trimSlots();
+        repackArchive();
+    }
+    return compactedGames;
+}
+
+void GameStore::trimSlots() {
+    size_t live = m_positions.size() - m_freeSlots.size();
+    std::vector<PackedPosition> starts;
+    std::vector<int64_t> lastActive;
+    std::vector<BoardState> positions;
+    std::vector<std::vector<EngineMove>> moves;
+    std::vector<std::vector<uint64_t>> keys;
+    std::vector<LegalMask> legal;
+    starts.reserve(live);
+    lastActive.reserve(live);
+    positions.reserve(live);
+    moves.reserve(live);
+    keys.reserve(live);
+    legal.reserve(live);
+    starts.emplace_back();
+    lastActive.push_back(0);
+    positions.emplace_back();
+    moves.emplace_back();
+    keys.emplace_back();
+    legal.emplace_back();
+    // free games sit in slot 0, which stays where it is
+    for (GameId id = 0; id < m_slot.size(); id++) {
+        uint32_t slot = m_slot[id];
+        if ((slot & COMPACTED) || slot == 0) {
+            continue;
+        }
+        m_slot[id] = static_cast<uint32_t>(positions.size());
+        starts.push_back(m_starts[slot]);
+        lastActive.push_back(m_lastActive[slot]);
+        positions.push_back(m_positions[slot]);
+        moves.push_back(std::move(m_moves[slot]));
+        keys.push_back(std::move(m_keys[slot]));
+        legal.push_back(m_legal[slot]);
+    }
+    m_starts.swap(starts);
+    m_lastActive.swap(lastActive);
+    m_positions.swap(positions);
+    m_moves.swap(moves);
+    m_keys.swap(keys);
+    m_legal.swap(legal);
+    std::vector<uint32_t>().swap(m_freeSlots);
+}
+
+uint32_t GameStore::wake(GameId id) {
+    if (!(m_slot[id] & COMPACTED)) {
+        m_lastActive[m_slot[id]] = m_now;
+        return m_slot[id];
+    }
+    uint32_t slot = acquireSlot();
+    const uint8_t* record = &m_archive[m_slot[id] & ~COMPACTED];
+    size_t bytes = recordBytes(record);
+    PackedPosition start;
+    std::memcpy(&start, record, sizeof(start));
+    BoardState board = start.unpack();
+    std::vector<EngineMove>& moves = m_moves[slot];
+    std::vector<uint64_t>& keys = m_keys[slot];
+    moves.reserve(bytes - RECORD_HEADER);
+    keys.assign(1, board.key);
+    for (size_t i = RECORD_HEADER; i < bytes; i++) {
+        EngineMove move = unpackMove(board, record[i]);
+        assert(!move.isNull() && "compact only archives moves it can pack");
+        bool reset = irreversible(board, move);
+        UndoInfo undo;
+        board.makeMove(move, undo);
+        moves.push_back(move);
+        if (reset) {
+            keys.clear();
+        }
+        keys.push_back(board.key);
+    }
+    m_positions[slot] = board;
+    if (m_status[id] == Status::ONGOING) {
+        generateLegalMask(board, m_legal[slot]);
+    }
+    m_archiveDead += bytes;
+    m_starts[slot] = start;
+    m_lastActive[slot] = m_now;
+    m_slot[id] = slot;
+    return slot;
+}
+
+uint32_t GameStore::acquireSlot() {
+    if (!m_freeSlots.empty()) {
+        uint32_t slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        return slot;
+    }
+    m_starts.emplace_back();
+    m_lastActive.push_back(0);
+    m_positions.emplace_back();
+    m_moves.emplace_back();
+    m_keys.emplace_back();
+    m_legal.emplace_back();
+    return static_cast<uint32_t>(m_positions.size() - 1);
+}
+
+// a released slot keeps its lists' capacity for the next game and an all-zero mask
+void GameStore::releaseSlot(uint32_t slot) {
+    m_moves[slot].clear();
+    m_keys[slot].clear();
+    m_legal[slot] = LegalMask{};
+    m_freeSlots.push_back(slot);
+}
+
+void GameStore::collectChanged(std::vector<GameId>& out) {
+    out.clear();
+    size_t n = m_changed.size();
+    for (size_t i = 0; i < n; i++) {
+        if (m_changed[i]) {
+            out.push_back(static_cast<GameId>(i));
+            m_changed[i] = 0;
+        }
+    }
+}
+
+template <typename T>
+static size_t heapBytes(const std::vector<T>& values) {
+    return values.capacity() * sizeof(T);
+}
+
+size_t GameStore::memoryBytes() const {
+    size_t bytes = heapBytes(m_status) + heapBytes(m_turn) + heapBytes(m_whiteClock) + heapBytes(m_blackClock) + heapBytes(m_increment) +
+        heapBytes(m_halfmoveClock) + heapBytes(m_key) + heapBytes(m_changed) + heapBytes(m_slot) + heapBytes(m_starts) +
+        heapBytes(m_lastActive) + heapBytes(m_positions) + heapBytes(m_moves) + heapBytes(m_keys) + heapBytes(m_legal) +
+        heapBytes(m_free) + heapBytes(m_freeSlots) + heapBytes(m_archive);
+    for (size_t i = 0; i < m_moves.size(); i++) {
+        bytes += heapBytes(m_moves[i]) + heapBytes(m_keys[i]);
+    }
+    return bytes;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "BoardState.h"
+#include "PackedGame.h"
+
+using GameId = uint32_t;
+
+// Every live game on a server, stored column by column. The fields a server tick reads for every
+// game (status, side to move, clocks, halfmove clock, position key) each sit in their own array
+// indexed by game ID, so a pass over 10k games streams through a few contiguous arrays and
+// vectorises. Positions, moves and repetition keys are only touched when a game is played, and
+// live in separate arrays so they never share cache lines with the hot fields.
+//
+// Those cold fields only exist for live games. A game left alone long enough can be compacted to
+// one record in a shared archive, its packed start position, a ply count and one byte per move,
+// and is replayed back into a live slot the next time it is played or looked at. With the slot
+// word that points at the record that is 38 bytes plus a byte a ply, next to the 25 bytes of hot
+// fields every ID has. The hot fields stay put, so ticks and status checks never wake a game.
+class GameStore {
+public:
+	// the last two end King of the Hill and Three-check games, in favour of the side that just moved
+	enum class Status : uint8_t { FREE, ONGOING, CHECKMATE, STALEMATE, REPETITION, FIFTY_MOVES, INSUFFICIENT_MATERIAL, WHITE_FLAGGED, BLACK_FLAGGED, HILL_REACHED, THIRD_CHECK };
+
+	GameStore();
+
+	// clocks are in milliseconds, the increment is added after each move; the game is played under
+	// the start position's variant
+	GameId create(const BoardState& start, int clockMs, int incrementMs = 0);
+
+	// the ID is reused by a later create
+	void remove(GameId id);
+
+	// plays a legal move, charging elapsedMs since the last tick to the mover; false if it is not
+	// legal or the game is over
+	bool play(GameId id, EngineMove move, int elapsedMs = 0);
+
+	// charges elapsedMs to the side to move in every ongoing game and ends the games that ran out
+	// of time or reached the fifty-move rule; returns how many ended
+	size_t tick(int elapsedMs);
+
+	// packs a live game, finished or not, freeing its position, move and key lists and legal mask;
+	// false, leaving it live, if it is free, already compacted, started from a position of more than
+	// 32 pieces, or has a move the packing does not know
+	bool compact(GameId id);
+	// compacts every live game nobody has played or looked at for idleMs of ticked time, then moves
+	// the live games' slots together and copies the archive to its exact size, so the freed memory
+	// goes back to the allocator; returns how many
+	size_t compactIdle(int64_t idleMs);
+	bool compacted(GameId id) const { return m_slot[id] & COMPACTED; }
+
+	// IDs of games that moved or ended since the last call, for pushing updates to spectators; clocks
+	// run down every tick and are left for spectators to extrapolate
+	void collectChanged(std::vector<GameId>& out);
+
+	Status status(GameId id) const { return m_status[id]; }
+	Piece::Color turn(GameId id) const { return m_turn[id] ? Piece::Color::BLACK : Piece::Color::WHITE; }
+	int clockMs(GameId id, Piece::Color color) const { return color == Piece::Color::WHITE ? m_whiteClock[id] : m_blackClock[id]; }
+	int halfmoveClock(GameId id) const { return m_halfmoveClock[id]; }
+	uint64_t key(GameId id) const { return m_key[id]; }
+
+	// the rest wake a compacted game, which may move other live games' fields, so references are
+	// only good until the next call that can wake one
+	const BoardState& position(GameId id) { return m_positions[wake(id)]; }
+	const std::vector<EngineMove>& moves(GameId id) { return m_moves[wake(id)]; }
+	// all zero once the game is over
+	const LegalMask& legalMask(GameId id) { return m_legal[wake(id)]; }
+	// where the game's mask is in legalMasks(); a free game's is always all zero
+	uint32_t slot(GameId id) { return wake(id); }
+	// every live game's mask by slot, for batched validation
+	const LegalMask* legalMasks() const { return m_legal.data(); }
+
+	// games in play, and the size of the ID range a pass covers
+	size_t size() const { return m_status.size() - m_free.size(); }
+	size_t capacity() const { return m_status.size(); }
+
+	// heap bytes held for every ID, free ones included; walks each game's move and key lists
+	size_t memoryBytes() const;
+
+private:
+	// set in the slot word of a compacted game, whose other bits are its record's offset in the
+	// archive; slot 0 is never handed out and stands for free games
+	static const uint32_t COMPACTED = 1u << 31;
+
+	// the game's slot, replaying it into one first if it was compacted
+	uint32_t wake(GameId id);
+	uint32_t acquireSlot();
+	void releaseSlot(uint32_t slot);
+	void trimSlots();
+	void repackArchive();
+
+	// hot, one entry per ID
+	std::vector<Status> m_status;
+	std::vector<uint8_t> m_turn;          // 0 white, 1 black
+	std::vector<int32_t> m_whiteClock;
+	std::vector<int32_t> m_blackClock;
+	std::vector<int32_t> m_increment;
+	std::vector<uint16_t> m_halfmoveClock;
+	std::vector<uint64_t> m_key;
+	std::vector<uint8_t> m_changed;
+
+	// cold, one entry per ID
+	std::vector<uint32_t> m_slot;
+
+	// cold, one entry per slot
+	std::vector<PackedPosition> m_starts;
+	std::vector<int64_t> m_lastActive;   // ticked time the game was last played or looked at
+	std::vector<BoardState> m_positions;
+	std::vector<std::vector<EngineMove>> m_moves;
+	std::vector<std::vector<uint64_t>> m_keys;   // every position's key since the last capture or pawn move
+	std::vector<LegalMask> m_legal;
+
+	std::vector<GameId> m_free;
+	std::vector<uint32_t> m_freeSlots;
+	std::vector<uint8_t> m_archive;   // compacted games' records back to back
+	size_t m_archiveDead = 0;         // bytes of records whose games were woken or removed
+	int64_t m_now = 0;   // every tick's elapsedMs added up
+};
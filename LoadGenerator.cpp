@@ -0,0 +1,271 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "ChessObjects.h"
+#include "GameServer.h"
+#include "Metrics.h"
+
+// Simulated clients playing random legal games against a GameServer over loopback, one connection
+// each, at several concurrency levels. Reports moves per second, move round-trip latency, the
+// server's memory per live game, and the size and speed of the move batches it validated.
+// usage: LoadGenerator [--clients 1,4,16,64] [--seconds 5] [--max-plies 200] [--port p]
+// with --port the clients go to a server already listening there instead of an in-process one
+
+struct ClientResult {
+    LatencyHistogram roundTrip;
+    uint64_t moves = 0;
+    uint64_t games = 0;
+    uint64_t rejected = 0;  // moves the server refused
+    uint64_t errors = 0;    // connections lost or refused
+};
+
+// blocking request and reply, one line each
+class LineSocket {
+public:
+    explicit LineSocket(uint16_t port) : m_fd(::socket(AF_INET, SOCK_STREAM, 0)) {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (m_fd >= 0 && ::connect(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        int yes = 1;
+        if (m_fd >= 0) {
+            ::setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        }
+    }
+    ~LineSocket() {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+    LineSocket(const LineSocket&) = delete;
+    LineSocket& operator=(const LineSocket&) = delete;
+
+    bool connected() const { return m_fd >= 0; }
+
+    bool request(const std::string& line, std::string& reply) {
+        std::string message = line + "\n";
+        size_t sent = 0;
+        while (sent < message.size()) {
+            ssize_t n = ::send(m_fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        size_t end;
+        while ((end = m_buffer.find('\n')) == std::string::npos) {
+            char chunk[256];
+            ssize_t n = ::recv(m_fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                return false;
+            }
+            m_buffer.append(chunk, static_cast<size_t>(n));
+        }
+        reply = m_buffer.substr(0, end);
+        m_buffer.erase(0, end + 1);
+        return true;
+    }
+
+private:
+    int m_fd;
+    std::string m_buffer;
+};
+
+static std::string squareName(const Position& pos) {
+    return { static_cast<char>('a' + pos.col), static_cast<char>('8' - pos.row) };
+}
+
+static void runClient(uint16_t port, int maxPlies, uint32_t seed, const std::atomic<bool>& stop, ClientResult& result) {
+    LineSocket socket(port);
+    if (!socket.connected()) {
+        result.errors++;
+        return;
+    }
+    const std::string ongoing = "OK " + std::to_string(static_cast<int>(GameStore::Status::ONGOING));
+    std::mt19937 rng(seed);
+    std::string reply;
+    std::vector<std::pair<Position, PositionType>> choices;
+
+    while (!stop) {
+        if (!socket.request("N", reply) || reply.compare(0, 2, "G ") != 0) {
+            result.errors++;
+            return;
+        }
+        std::string id = reply.substr(2);
+
+        // the game picks the colours; its players are copies, the moves go through these
+        Player first, second;
+        Game game(first, second);
+        Player& white = first.getColor() == Piece::Color::WHITE ? first : second;
+        Player& black = first.getColor() == Piece::Color::WHITE ? second : first;
+        Piece::Color turn = Piece::Color::WHITE;
+
+        for (int ply = 0; ply < maxPlies && !stop; ply++) {
+            Player& mover = turn == Piece::Color::WHITE ? white : black;
+            choices.clear();
+            for (const auto& entry : game.legalMoves(mover)) {
+                for (const PositionType& target : entry.second) {
+                    choices.push_back({ entry.first, target });
+                }
+            }
+            if (choices.empty()) {
+                break;
+            }
+            const auto& [from, target] = choices[rng() % choices.size()];
+            Move move(from, Position(target.pair.first, target.pair.second));
+            std::string uci = squareName(move.m_from) + squareName(move.m_to) + (target.mtype == PositionType::MoveType::PROM ? "q" : "");
+
+            uint64_t start = Metrics::now();
+            if (!socket.request("M " + id + " " + uci, reply)) {
+                result.errors++;
+                return;
+            }
+            result.roundTrip.add(Metrics::now() - start);
+            if (reply.compare(0, 3, "OK ") != 0) {
+                // the object board and the server disagree on the move; the game cannot go on
+                result.rejected++;
+                break;
+            }
+            result.moves++;
+            PositionType::MoveType mtype = target.mtype;
+            game.makeMove(mover, move, mtype, game.getLastMove(), Piece::PieceType::QUEEN);
+            game.addMoveToHistory(move);
+            turn = turn == Piece::Color::WHITE ? Piece::Color::BLACK : Piece::Color::WHITE;
+            if (reply != ongoing) {
+                break;
+            }
+        }
+        if (!socket.request("E " + id, reply)) {
+            result.errors++;
+            return;
+        }
+        result.games++;
+    }
+}
+
+struct LevelResult {
+    int clients = 0;
+    double movesPerSecond = 0.0;
+    LatencyHistogram roundTrip;
+    uint64_t games = 0;
+    uint64_t rejected = 0;
+    uint64_t errors = 0;
+    uint64_t liveGames = 0;
+    uint64_t serverBytes = 0;
+    // the server's move batches so far, as totals
+    uint64_t batches = 0;
+    uint64_t batchMoves = 0;
+    uint64_t batchNanos = 0;
+};
+
+static LevelResult runLevel(uint16_t port, int clients, int seconds, int maxPlies) {
+    LevelResult level;
+    level.clients = clients;
+    std::atomic<bool> stop{ false };
+    std::vector<ClientResult> results(clients);
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < clients; i++) {
+        threads.emplace_back(runClient, port, maxPlies, static_cast<uint32_t>(i + 1), std::cref(stop), std::ref(results[i]));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+
+    // memory is read while every client still has a game open
+    LineSocket control(port);
+    std::string reply;
+    if (control.connected() && control.request("S", reply)) {
+        std::istringstream in(reply.substr(reply.size() > 2 ? 2 : reply.size()));
+        in >> level.liveGames >> level.serverBytes >> level.batches >> level.batchMoves >> level.batchNanos;
+    }
+    stop = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t moves = 0;
+    for (const ClientResult& result : results) {
+        level.roundTrip.merge(result.roundTrip);
+        moves += result.moves;
+        level.games += result.games;
+        level.rejected += result.rejected;
+        level.errors += result.errors;
+    }
+    level.movesPerSecond = moves / elapsed;
+    return level;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<int> levels = { 1, 4, 16, 64 };
+    int seconds = 5;
+    int maxPlies = 200;
+    int port = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--clients") && i + 1 < argc) {
+            levels.clear();
+            std::istringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                levels.push_back(std::max(1, std::stoi(item)));
+            }
+        }
+        else if (!std::strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            seconds = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--max-plies") && i + 1 < argc) {
+            maxPlies = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--port") && i + 1 < argc) {
+            port = std::stoi(argv[++i]);
+        }
+    }
+
+    std::unique_ptr<GameServer> server;
+    if (port == 0) {
+        server = std::make_unique<GameServer>();
+        if (!server->start()) {
+            return 1;
+        }
+        port = server->port();
+    }
+
+    std::cout << std::setw(8) << "clients" << std::setw(12) << "moves/s" << std::setw(10) << "p50 us" << std::setw(10) << "p99 us"
+        << std::setw(10) << "p999 us" << std::setw(10) << "max us" << std::setw(8) << "games" << std::setw(12) << "bytes/game"
+        << std::setw(10) << "rejected" << std::setw(8) << "errors" << std::setw(12) << "moves/batch" << std::setw(12) << "batch M/s" << std::endl;
+    LevelResult previous;
+    for (int clients : levels) {
+        LevelResult level = runLevel(static_cast<uint16_t>(port), clients, seconds, maxPlies);
+        const LatencyHistogram& rtt = level.roundTrip;
+        // the server's totals are read partway through each level, so a level's batches are the
+        // difference from the last reading
+        uint64_t batches = level.batches - previous.batches;
+        uint64_t batchMoves = level.batchMoves - previous.batchMoves;
+        uint64_t batchNanos = level.batchNanos - previous.batchNanos;
+        previous = level;
+        std::cout << std::setw(8) << clients << std::fixed << std::setprecision(0) << std::setw(12) << level.movesPerSecond
+            << std::setprecision(1) << std::setw(10) << rtt.quantile(0.5) / 1e3 << std::setw(10) << rtt.quantile(0.99) / 1e3
+            << std::setw(10) << rtt.quantile(0.999) / 1e3 << std::setw(10) << rtt.max / 1e3 << std::setw(8) << level.liveGames
+            << std::setw(12) << (level.liveGames ? level.serverBytes / level.liveGames : 0) << std::setw(10) << level.rejected
+            << std::setw(8) << level.errors << std::setprecision(2) << std::setw(12) << (batches ? static_cast<double>(batchMoves) / batches : 0.0)
+            << std::setw(12) << (batchNanos ? batchMoves * 1e3 / batchNanos : 0.0) << std::endl;
+    }
+    return 0;
+}
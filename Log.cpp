@@ -0,0 +1,182 @@
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+
+static const size_t LOG_CAPACITY = 4096;
+
+static const char* levelName(LogLevel level) {
+    static const char* names[] = { "trace", "debug", "info", "warn", "error", "off" };
+    return names[static_cast<int>(level)];
+}
+
+static uint32_t threadNumber() {
+    static std::atomic<uint32_t> next{ 0 };
+    thread_local uint32_t number = next++;
+    return number;
+}
+
+// CHESS_LOG_LEVEL=trace|debug|info|warn|error|off sets the starting level
+static LogLevel levelFromEnvironment() {
+    const char* name = std::getenv("CHESS_LOG_LEVEL");
+    if (name) {
+        for (int level = 0; level <= static_cast<int>(LogLevel::OFF); level++) {
+            if (std::strcmp(name, levelName(static_cast<LogLevel>(level))) == 0) {
+                return static_cast<LogLevel>(level);
+            }
+        }
+    }
+    return LogLevel::INFO;
+}
+
+Logger& Logger::instance() {
+    static Logger logger(LOG_CAPACITY);
+    return logger;
+}
+
+Logger::Logger(size_t capacity)
+    : m_slots(new Slot[capacity]), m_mask(capacity - 1), m_head(0), m_written(0), m_signal(0), m_dropped(0),
+    m_level(levelFromEnvironment()), m_quit(false), m_sink(stderr), m_format(Format::TEXT) {
+    for (size_t i = 0; i < capacity; i++) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    m_writer = std::thread(&Logger::writerLoop, this);
+}
+
+Logger::~Logger() {
+    m_quit.store(true);
+    m_signal.fetch_add(1);
+    m_signal.notify_one();
+    m_writer.join();
+}
+
+void Logger::setLevel(LogLevel level) {
+    m_level.store(level, std::memory_order_relaxed);
+}
+
+LogLevel Logger::level() const {
+    return m_level.load(std::memory_order_relaxed);
+}
+
+void Logger::setFormat(Format format) {
+    std::lock_guard<std::mutex> lock(m_sinkMutex);
+    m_format = format;
+}
+
+void Logger::setSink(std::FILE* sink) {
+    flush();
+    std::lock_guard<std::mutex> lock(m_sinkMutex);
+    m_sink = sink;
+}
+
+uint64_t Logger::dropped() const {
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+bool Logger::log(LogLevel level, const char* category, std::string_view text) {
+    // bounded multi-producer queue: a slot is free for position pos when its sequence equals pos
+    uint64_t pos = m_head.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &m_slots[pos & m_mask];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    LogRecord& record = slot->record;
+    record.timeUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    record.thread = threadNumber();
+    record.level = level;
+    record.category = category;
+    record.length = static_cast<uint16_t>(std::min(text.size(), sizeof(record.text)));
+    std::memcpy(record.text, text.data(), record.length);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+    return true;
+}
+
+void Logger::flush() {
+    uint64_t target = m_head.load(std::memory_order_acquire);
+    uint64_t written = m_written.load(std::memory_order_acquire);
+    while (written < target) {
+        m_written.wait(written);
+        written = m_written.load(std::memory_order_acquire);
+    }
+}
+
+void Logger::writerLoop() {
+    uint64_t tail = 0;
+    while (true) {
+        uint32_t seen = m_signal.load(std::memory_order_acquire);
+        bool wrote = false;
+        {
+            std::lock_guard<std::mutex> lock(m_sinkMutex);
+            while (true) {
+                Slot& slot = m_slots[tail & m_mask];
+                if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+                    break;
+                }
+                write(slot.record);
+                slot.sequence.store(tail + m_mask + 1, std::memory_order_release);
+                tail++;
+                wrote = true;
+            }
+            if (wrote) {
+                std::fflush(m_sink);
+            }
+        }
+        if (wrote) {
+            m_written.store(tail, std::memory_order_release);
+            m_written.notify_all();
+            continue;
+        }
+        if (m_quit.load()) {
+            return;
+        }
+        m_signal.wait(seen, std::memory_order_acquire);
+    }
+}
+
+void Logger::write(const LogRecord& record) {
+    std::string_view text(record.text, record.length);
+    uint64_t seconds = record.timeUs / 1000000;
+    unsigned micros = static_cast<unsigned>(record.timeUs % 1000000);
+    if (m_format == Format::TEXT) {
+        std::fprintf(m_sink, "%llu.%06u %-5s [%u] %s: %.*s\n", static_cast<unsigned long long>(seconds), micros,
+            levelName(record.level), record.thread, record.category, static_cast<int>(text.size()), text.data());
+        return;
+    }
+
+    std::fprintf(m_sink, "{\"ts\":%llu.%06u,\"level\":\"%s\",\"thread\":%u,\"category\":\"%s\",\"msg\":\"",
+        static_cast<unsigned long long>(seconds), micros, levelName(record.level), record.thread, record.category);
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', m_sink);
+            std::fputc(c, m_sink);
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            std::fprintf(m_sink, "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+        }
+        else {
+            std::fputc(c, m_sink);
+        }
+    }
+    std::fputs("\"}\n", m_sink);
+}
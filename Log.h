@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+enum class LogLevel : uint8_t { TRACE, DEBUG, INFO, WARN, ERROR, OFF };
+
+struct LogRecord {
+	uint64_t timeUs;          // since the epoch
+	uint32_t thread;          // small per-process number, in order of each thread's first log
+	LogLevel level;
+	uint16_t length;
+	const char* category;     // a string literal, only the pointer is kept
+	char text[224];           // longer messages are cut
+};
+
+// Levelled logging that never waits on I/O. Callers format their message and copy it into a
+// bounded lock-free ring; a background thread writes the records out as text or JSON lines and
+// flushes only when the ring runs dry. A full ring drops the record and counts it rather than
+// block the caller.
+class Logger {
+public:
+	enum class Format { TEXT, JSON };
+
+	static Logger& instance();
+
+	~Logger();
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+
+	bool enabled(LogLevel level) const { return level >= m_level.load(std::memory_order_relaxed); }
+	void setLevel(LogLevel level);
+	LogLevel level() const;
+
+	// stderr and TEXT until changed; the sink stays owned by the caller
+	void setFormat(Format format);
+	void setSink(std::FILE* sink);
+
+	// false when the ring is full and the record was dropped
+	bool log(LogLevel level, const char* category, std::string_view text);
+
+	// returns once everything logged before the call has been written
+	void flush();
+
+	uint64_t dropped() const;
+
+private:
+	explicit Logger(size_t capacity);
+
+	void writerLoop();
+	void write(const LogRecord& record);
+
+	struct Slot {
+		std::atomic<uint64_t> sequence;  // the position it can be claimed at, plus one once filled
+		LogRecord record;
+	};
+
+	std::unique_ptr<Slot[]> m_slots;
+	size_t m_mask;
+	alignas(64) std::atomic<uint64_t> m_head;      // next position producers claim
+	alignas(64) std::atomic<uint64_t> m_written;   // positions written out, only the writer advances it
+	std::atomic<uint32_t> m_signal;                // bumped on every log so the writer can sleep on it
+	std::atomic<uint64_t> m_dropped;
+	std::atomic<LogLevel> m_level;
+	std::atomic<bool> m_quit;
+
+	std::mutex m_sinkMutex;                        // sink and format changes against the writer
+	std::FILE* m_sink;
+	Format m_format;
+	std::thread m_writer;
+};
+
+// collects one message with operator<< and hands it to the logger when it goes out of scope
+class LogStream {
+public:
+	LogStream(LogLevel level, const char* category) : m_level(level), m_category(category) {}
+	~LogStream() { Logger::instance().log(m_level, m_category, m_stream.view()); }
+
+	template <typename T>
+	LogStream& operator<<(const T& value) {
+		m_stream << value;
+		return *this;
+	}
+
+private:
+	LogLevel m_level;
+	const char* m_category;
+	std::ostringstream m_stream;
+};
+
+// the message is only formatted when the level is enabled; category must be a string literal
+#define CHESS_LOG(level, category, message) \
+	do { \
+		if (Logger::instance().enabled(level)) { \
+			LogStream{ level, category } << message; \
+		} \
+	} while (0)
+
+#define LOG_INFO(category, message) CHESS_LOG(LogLevel::INFO, category, message)
+#define LOG_WARN(category, message) CHESS_LOG(LogLevel::WARN, category, message)
+#define LOG_ERROR(category, message) CHESS_LOG(LogLevel::ERROR, category, message)
+
+// hot-path output, compiled out of release builds unless CHESS_DEBUG_LOGGING is defined
+#if defined(NDEBUG) && !defined(CHESS_DEBUG_LOGGING)
+#define LOG_DEBUG(category, message) do {} while (0)
+#define LOG_TRACE(category, message) do {} while (0)
+#else
+#define LOG_DEBUG(category, message) CHESS_LOG(LogLevel::DEBUG, category, message)
+#define LOG_TRACE(category, message) CHESS_LOG(LogLevel::TRACE, category, message)
+#endif
@@ -0,0 +1,263 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+
+struct Metrics::ThreadBlock {
+    struct StageData {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[LatencyHistogram::BUCKETS];
+    };
+
+    // only the thread holding the block writes these; anyone may read them
+    StageData stages[STAGE_COUNT];
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    std::atomic<bool> inUse;
+    ThreadBlock* next = nullptr;
+};
+
+static const char* stageNames[] = { "legal_moves", "puts_king_in_check", "make_move", "net_send", "net_receive", "move_batch" };
+static_assert(std::size(stageNames) == STAGE_COUNT);
+
+static const struct {
+    const char* name;
+    const char* help;
+} counterNames[] = {
+    { "chess_moves_generated_total", "Legal moves returned by Player::legalMoves." },
+    { "chess_moves_played_total", "Moves applied with Game::makeMove." },
+    { "chess_messages_sent_total", "Network messages sent." },
+    { "chess_messages_received_total", "Network messages received." },
+    { "chess_sent_bytes_total", "Network bytes sent." },
+    { "chess_received_bytes_total", "Network bytes received." },
+    { "chess_moves_validated_total", "Client moves checked by MoveBatch::validate." },
+    { "chess_moves_rejected_total", "Client moves MoveBatch::validate found illegal." },
+};
+static_assert(std::size(counterNames) == COUNTER_COUNT);
+
+// histogram edges in the export, powers of two from 128ns to about a second; they fall on bucket
+// boundaries so the cumulative counts need no interpolation
+static const int EXPORT_FIRST_POWER = 7;
+static const int EXPORT_LAST_POWER = 30;
+
+// a single writer, so no read-modify-write instruction is needed
+static void bump(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count))));
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < BUCKETS - 1; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= target) {
+            return std::min(lowerBound(bucket + 1) - 1, max);
+        }
+    }
+    return max;
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+// CHESS_METRICS=1 turns recording on; any other value but 0 is also a file to export to every second
+Metrics::Metrics() : m_blocks(nullptr), m_enabled(false), m_exportQuit(false) {
+    const char* setting = std::getenv("CHESS_METRICS");
+    if (setting && std::strcmp(setting, "0") != 0) {
+        m_enabled.store(true, std::memory_order_relaxed);
+        if (std::strcmp(setting, "1") != 0) {
+            exportToFile(setting, std::chrono::seconds(1));
+        }
+    }
+}
+
+Metrics::~Metrics() {
+    stopExport();
+    ThreadBlock* block = m_blocks.load();
+    while (block) {
+        ThreadBlock* next = block->next;
+        delete block;
+        block = next;
+    }
+}
+
+void Metrics::setEnabled(bool enabled) {
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+Metrics::ThreadBlock& Metrics::local() {
+    // gives the block back when the thread exits, keeping its counts for the next thread
+    struct Lease {
+        ThreadBlock* block = nullptr;
+        ~Lease() {
+            if (block) {
+                block->inUse.store(false, std::memory_order_release);
+            }
+        }
+    };
+    thread_local Lease lease;
+
+    if (!lease.block) {
+        ThreadBlock* block = m_blocks.load(std::memory_order_acquire);
+        for (; block; block = block->next) {
+            bool free = false;
+            if (block->inUse.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+                break;
+            }
+        }
+        if (!block) {
+            block = new ThreadBlock();
+            block->inUse.store(true, std::memory_order_relaxed);
+            block->next = m_blocks.load(std::memory_order_relaxed);
+            while (!m_blocks.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {
+            }
+        }
+        lease.block = block;
+    }
+    return *lease.block;
+}
+
+void Metrics::record(Stage stage, uint64_t ns) {
+    ThreadBlock::StageData& data = local().stages[static_cast<int>(stage)];
+    bump(data.buckets[LatencyHistogram::bucketOf(ns)], 1);
+    bump(data.count, 1);
+    bump(data.sum, ns);
+    if (ns > data.max.load(std::memory_order_relaxed)) {
+        data.max.store(ns, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::add(Counter counter, uint64_t amount) {
+    bump(local().counters[static_cast<int>(counter)], amount);
+}
+
+LatencyHistogram Metrics::histogram(Stage stage) const {
+    LatencyHistogram total;
+    for (ThreadBlock* block = m_blocks.load(std::memory_order_acquire); block; block = block->next) {
+        const ThreadBlock::StageData& data = block->stages[static_cast<int>(stage)];
+        total.count += data.count.load(std::memory_order_relaxed);
+        total.sum += data.sum.load(std::memory_order_relaxed);
+        total.max = std::max(total.max, data.max.load(std::memory_order_relaxed));
+        for (int bucket = 0; bucket < LatencyHistogram::BUCKETS; bucket++) {
+            total.buckets[bucket] += data.buckets[bucket].load(std::memory_order_relaxed);
+        }
+    }
+    return total;
+}
+
+uint64_t Metrics::counter(Counter counter) const {
+    uint64_t total = 0;
+    for (ThreadBlock* block = m_blocks.load(std::memory_order_acquire); block; block = block->next) {
+        total += block->counters[static_cast<int>(counter)].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+static void appendSeconds(std::string& out, uint64_t ns) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", static_cast<double>(ns) / 1e9);
+    out += text;
+}
+
+std::string Metrics::render() const {
+    std::string out;
+    out += "# HELP chess_stage_latency_seconds Time spent in each stage of a turn.\n";
+    out += "# TYPE chess_stage_latency_seconds histogram\n";
+    LatencyHistogram histograms[STAGE_COUNT];
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        const LatencyHistogram& h = histograms[stage] = histogram(static_cast<Stage>(stage));
+        std::string labels = std::string("stage=\"") + stageNames[stage] + "\"";
+
+        // the counts are read one bucket at a time while threads record, so the total is taken
+        // from the buckets to keep the series consistent
+        uint64_t cumulative = 0;
+        int bucket = 0;
+        for (int power = EXPORT_FIRST_POWER; power <= EXPORT_LAST_POWER; power++) {
+            for (; LatencyHistogram::lowerBound(bucket) < (1ull << power); bucket++) {
+                cumulative += h.buckets[bucket];
+            }
+            out += "chess_stage_latency_seconds_bucket{" + labels + ",le=\"";
+            appendSeconds(out, 1ull << power);
+            out += "\"} " + std::to_string(cumulative) + "\n";
+        }
+        for (; bucket < LatencyHistogram::BUCKETS; bucket++) {
+            cumulative += h.buckets[bucket];
+        }
+        out += "chess_stage_latency_seconds_bucket{" + labels + ",le=\"+Inf\"} " + std::to_string(cumulative) + "\n";
+        out += "chess_stage_latency_seconds_sum{" + labels + "} ";
+        appendSeconds(out, h.sum);
+        out += "\nchess_stage_latency_seconds_count{" + labels + "} " + std::to_string(cumulative) + "\n";
+    }
+
+    // the fine buckets give closer quantiles than the exported edges
+    out += "# HELP chess_stage_latency_quantile_seconds Latency quantiles of each stage, to within 1/16.\n";
+    out += "# TYPE chess_stage_latency_quantile_seconds gauge\n";
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        for (const char* q : { "0.5", "0.9", "0.99", "0.999", "1" }) {
+            out += std::string("chess_stage_latency_quantile_seconds{stage=\"") + stageNames[stage] + "\",quantile=\"" + q + "\"} ";
+            appendSeconds(out, histograms[stage].quantile(std::atof(q)));
+            out += "\n";
+        }
+    }
+
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        out += std::string("# HELP ") + counterNames[counter].name + " " + counterNames[counter].help + "\n";
+        out += std::string("# TYPE ") + counterNames[counter].name + " counter\n";
+        out += std::string(counterNames[counter].name) + " " + std::to_string(this->counter(static_cast<Counter>(counter))) + "\n";
+    }
+    return out;
+}
+
+bool Metrics::writeFile(const std::string& path) const {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out << render();
+        if (!out) {
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+void Metrics::exportToFile(const std::string& path, std::chrono::milliseconds interval) {
+    stopExport();
+    m_exportQuit = false;
+    m_exporter = std::thread([this, path, interval] {
+        std::unique_lock<std::mutex> lock(m_exportMutex);
+        while (!m_exportWake.wait_for(lock, interval, [this] { return m_exportQuit; })) {
+            writeFile(path);
+        }
+        // once more on the way out so the file ends up with the final counts
+        writeFile(path);
+    });
+}
+
+void Metrics::stopExport() {
+    if (!m_exporter.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_exportMutex);
+        m_exportQuit = true;
+    }
+    m_exportWake.notify_all();
+    m_exporter.join();
+}
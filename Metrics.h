@@ -0,0 +1,157 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// the parts of a turn whose latency is recorded; legal moves includes its puts-king-in-check calls,
+// the network stages belong to whoever does the I/O, and a move batch is one MoveBatch::validate
+enum class Stage : uint8_t { LEGAL_MOVES, PUTS_KING_IN_CHECK, MAKE_MOVE, NET_SEND, NET_RECEIVE, MOVE_BATCH, COUNT };
+
+enum class Counter : uint8_t { MOVES_GENERATED, MOVES_PLAYED, MESSAGES_SENT, MESSAGES_RECEIVED, BYTES_SENT, BYTES_RECEIVED, MOVES_VALIDATED, MOVES_REJECTED, COUNT };
+
+static constexpr int STAGE_COUNT = static_cast<int>(Stage::COUNT);
+static constexpr int COUNTER_COUNT = static_cast<int>(Counter::COUNT);
+
+// Latencies in nanoseconds, bucketed log-linearly like an HDR histogram: exact below 16, then 16
+// buckets to every power of two, so a bucket is never wider than a sixteenth of its values.
+struct LatencyHistogram {
+	static constexpr int SUB_BITS = 4;
+	static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+	static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+	static constexpr int bucketOf(uint64_t ns) {
+		if (ns < SUB_BUCKETS) {
+			return static_cast<int>(ns);
+		}
+		int exponent = std::bit_width(ns) - 1;
+		int sub = static_cast<int>(ns >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+		return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+	}
+
+	// smallest latency that lands in the bucket
+	static constexpr uint64_t lowerBound(int bucket) {
+		if (bucket < SUB_BUCKETS) {
+			return static_cast<uint64_t>(bucket);
+		}
+		int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+		return static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - SUB_BITS);
+	}
+
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t max = 0;
+	uint64_t buckets[BUCKETS] = {};
+
+	void add(uint64_t ns) {
+		buckets[bucketOf(ns)]++;
+		count++;
+		sum += ns;
+		max = ns > max ? ns : max;
+	}
+
+	void merge(const LatencyHistogram& other) {
+		for (int bucket = 0; bucket < BUCKETS; bucket++) {
+			buckets[bucket] += other.buckets[bucket];
+		}
+		count += other.count;
+		sum += other.sum;
+		max = other.max > max ? other.max : max;
+	}
+
+	// upper edge of the bucket holding the q-th quantile, 0 < q <= 1; 0 when empty
+	uint64_t quantile(double q) const;
+	double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+};
+
+static_assert(LatencyHistogram::bucketOf(15) == 15 && LatencyHistogram::bucketOf(16) == 16 && LatencyHistogram::bucketOf(33) == 32);
+static_assert(LatencyHistogram::lowerBound(LatencyHistogram::bucketOf(1000)) <= 1000);
+static_assert(LatencyHistogram::bucketOf(~0ull) == LatencyHistogram::BUCKETS - 1);
+
+// Per-stage latency histograms and counters for the hot paths. Each thread records into its own
+// block with plain relaxed stores, so recording never contends; readers sum every thread's block
+// without locking. Blocks are kept when their thread exits and handed to the next new thread, so
+// totals only grow. Nothing is timed until enabled, leaving one relaxed load per call site.
+class Metrics {
+public:
+	static Metrics& instance();
+
+	~Metrics();
+	Metrics(const Metrics&) = delete;
+	Metrics& operator=(const Metrics&) = delete;
+
+	bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+	void setEnabled(bool enabled);
+
+	void record(Stage stage, uint64_t ns);
+	void add(Counter counter, uint64_t amount = 1);
+
+	// summed over every thread, as of roughly now
+	LatencyHistogram histogram(Stage stage) const;
+	uint64_t counter(Counter counter) const;
+
+	// Prometheus text exposition format
+	std::string render() const;
+
+	// replaces the file in one rename, so a scraper never reads half of it
+	bool writeFile(const std::string& path) const;
+
+	// a background thread rewrites the file every interval until stopped or the process exits
+	void exportToFile(const std::string& path, std::chrono::milliseconds interval);
+	void stopExport();
+
+	static uint64_t now() {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+private:
+	Metrics();
+
+	struct ThreadBlock;
+	ThreadBlock& local();
+
+	std::atomic<ThreadBlock*> m_blocks;  // pushed onto, never unlinked
+	std::atomic<bool> m_enabled;
+
+	std::mutex m_exportMutex;
+	std::condition_variable m_exportWake;
+	std::thread m_exporter;
+	bool m_exportQuit;
+};
+
+// times the rest of the enclosing scope as one stage, when metrics are enabled
+class StageTimer {
+public:
+	explicit StageTimer(Stage stage) : m_stage(stage), m_start(Metrics::instance().enabled() ? Metrics::now() : 0) {}
+	~StageTimer() {
+		if (m_start) {
+			Metrics::instance().record(m_stage, Metrics::now() - m_start);
+		}
+	}
+	StageTimer(const StageTimer&) = delete;
+	StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+	Stage m_stage;
+	uint64_t m_start;
+};
+
+// CHESS_NO_METRICS compiles the call sites out altogether; amount is only evaluated when enabled
+#ifdef CHESS_NO_METRICS
+#define METRICS_TIMER(stage) do {} while (0)
+#define METRICS_ADD(counter, amount) do {} while (0)
+#else
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_TIMER(stage) StageTimer METRICS_CONCAT(stageTimer_, __LINE__){ stage }
+#define METRICS_ADD(counter, amount) \
+	do { \
+		if (Metrics::instance().enabled()) { \
+			Metrics::instance().add(counter, amount); \
+		} \
+	} while (0)
+#endif
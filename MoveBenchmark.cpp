@@ -0,0 +1,397 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "ChessObjects.h"
+#include "GameSnapshot.h"
+#include "GameStore.h"
+#include "MoveValidator.h"
+
+// Microbenchmarks for the object board: validMoves per piece type, the check and legality helpers
+// of Player and a whole Game::makeMove turn, timed over a fixed set of positions, and
+// Game::legalMoves kept up to date through a whole game in each of its update modes. Also times
+// the server's batched move validation, after checking that its kernel agrees with a plain loop
+// and with the engine's legal moves; a disagreement is reported and fails the run.
+// usage: MoveBenchmark [--json file] [--filter text] [--min-ms ms]
+
+static const char* corpus[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR b KQkq - 4 4",
+    "4k3/8/8/8/8/8/4q3/4K3 w - - 0 1",                             // in check
+    "8/P6k/8/8/8/8/6Kp/8 b - - 0 1",                                // promotions
+};
+
+// a whole game replayed for the legal-move updates, Morphy's opera game in UCI notation
+static const char* operaGame[] = {
+    "e2e4", "e7e5", "g1f3", "d7d6", "d2d4", "c8g4", "d4e5", "g4f3", "d1f3", "d6e5", "f1c4", "g8f6", "f3b3", "d8e7", "b1c3", "c7c6",
+    "c1g5", "b7b5", "c3b5", "c6b5", "c4b5", "b8d7", "e1c1", "a8d8", "d1d7", "d8d7", "h1d1", "e7e6", "b5d7", "f6d7", "b3b8", "d7b8", "d1d8",
+};
+
+// everything a case needs for one corpus position, built once outside the timed loops
+struct Fixture {
+    BoardState position;
+    Board board;
+    std::vector<std::vector<Piece*>> state;
+    Player player;
+    LegalMoves legal;
+    std::vector<std::pair<Move, PositionType::MoveType>> moves;
+
+    explicit Fixture(const BoardState& start) : position(start), board(start, nullptr), state(board.getState()) {
+        int king = position.kingSquare(position.turn);
+        Position kingPos(rowOf(king), colOf(king));
+        player.setColor(position.turn);
+        player.setKingpos(kingPos);
+        legal = player.legalMoves(state, nullptr);
+        for (const auto& entry : legal) {
+            for (const PositionType& target : entry.second) {
+                moves.push_back({ Move(entry.first, Position(target.pair.first, target.pair.second)), target.mtype });
+            }
+        }
+    }
+};
+
+struct BenchmarkResult {
+    std::string name;
+    uint64_t iterations = 0;   // passes over the corpus
+    uint64_t operations = 0;   // calls timed in every pass
+    double nsPerOp = 0.0;      // best of the samples
+    double meanNsPerOp = 0.0;
+};
+
+// results go somewhere the optimiser cannot see through
+static volatile size_t sink;
+
+static BenchmarkResult runCase(const std::string& name, size_t operations, const std::function<size_t()>& pass, int minMs) {
+    using Clock = std::chrono::steady_clock;
+    const int samples = 5;
+    BenchmarkResult result;
+    result.name = name;
+
+    // calibrate one sample to about minMs / samples
+    uint64_t iterations = 1;
+    while (true) {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            sink = pass();
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (ms >= static_cast<double>(minMs) / samples || iterations >= (1ull << 30)) {
+            break;
+        }
+        iterations *= ms < 1.0 ? 10 : 2;
+    }
+
+    double best = 1e300, total = 0.0;
+    for (int s = 0; s < samples; s++) {
+        auto start = Clock::now();
+        for (uint64_t i = 0; i < iterations; i++) {
+            sink = pass();
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        double perOp = ns / static_cast<double>(iterations * std::max<size_t>(operations, 1));
+        best = std::min(best, perOp);
+        total += perOp;
+    }
+    result.iterations = iterations * samples;
+    result.operations = operations;
+    result.nsPerOp = best;
+    result.meanNsPerOp = total / samples;
+    return result;
+}
+
+static size_t validMovesOf(std::deque<Fixture>& fixtures, Piece::PieceType::Type type) {
+    size_t found = 0;
+    for (Fixture& fixture : fixtures) {
+        for (const auto& row : fixture.state) {
+            for (Piece* piece : row) {
+                if (piece && piece->getType().type == type) {
+                    found += piece->validMoves(fixture.state, nullptr).size();
+                }
+            }
+        }
+    }
+    return found;
+}
+
+static size_t countPieces(std::deque<Fixture>& fixtures, Piece::PieceType::Type type) {
+    size_t count = 0;
+    for (Fixture& fixture : fixtures) {
+        for (const auto& row : fixture.state) {
+            count += std::count_if(row.begin(), row.end(), [type](Piece* piece) { return piece && piece->getType().type == type; });
+        }
+    }
+    return count;
+}
+
+// client moves over games played a random number of plies, about half of them legal: taken from
+// the legal moves, or random squares that are checked against them
+static const int BATCH_GAMES = 1000;
+static const size_t BATCH_MOVES = 50000;
+
+static void buildMoveBatch(GameStore& store, MoveBatch& batch, std::vector<uint8_t>& expected) {
+    std::mt19937 random(1);
+    std::vector<GameId> games;
+    std::vector<MoveList> legal(BATCH_GAMES);
+    for (int g = 0; g < BATCH_GAMES; g++) {
+        GameId id = store.create(BoardState::startPosition(), 1 << 30);
+        int plies = static_cast<int>(random() % 80);
+        for (int ply = 0; ply < plies && store.status(id) == GameStore::Status::ONGOING; ply++) {
+            MoveList moves;
+            BoardState position = store.position(id);
+            generateLegalMoves(position, moves);
+            store.play(id, moves.moves[random() % moves.size]);
+        }
+        if (store.status(id) == GameStore::Status::ONGOING) {
+            BoardState position = store.position(id);
+            generateLegalMoves(position, legal[g]);
+        }
+        games.push_back(id);
+    }
+    for (size_t i = 0; i < BATCH_MOVES; i++) {
+        int g = static_cast<int>(random() % BATCH_GAMES);
+        const MoveList& moves = legal[g];
+        int from = static_cast<int>(random() % 64), to = static_cast<int>(random() % 64);
+        if (moves.size && random() % 2) {
+            EngineMove move = moves.moves[random() % moves.size];
+            from = move.from();
+            to = move.to();
+        }
+        batch.add(games[g], from, to);
+        expected.push_back(std::any_of(moves.begin(), moves.end(), [from, to](EngineMove move) { return move.from() == from && move.to() == to; }));
+    }
+}
+
+// the plain bit test the kernels are checked against
+static size_t validatePlain(const LegalMask* masks, const std::vector<PendingMove>& moves, uint8_t* valid) {
+    size_t legal = 0;
+    for (size_t i = 0; i < moves.size(); i++) {
+        valid[i] = (masks[moves[i].game].destinations[moves[i].from] >> moves[i].to) & 1;
+        legal += valid[i];
+    }
+    return legal;
+}
+
+static void writeJson(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    out << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n    \"positions\": " << std::size(corpus) << ",\n"
+        << "    \"build\": \"" <<
+#ifdef NDEBUG
+        "release"
+#else
+        "debug"
+#endif
+        << "\"\n  },\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult& r = results[i];
+        out << "    { \"name\": \"" << r.name << "\", \"iterations\": " << r.iterations << ", \"operations\": " << r.operations
+            << ", \"ns_per_op\": " << std::fixed << std::setprecision(1) << r.nsPerOp << ", \"mean_ns_per_op\": " << r.meanNsPerOp << " }"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::string jsonPath, filter;
+    int minMs = 500;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--json") && i + 1 < argc) {
+            jsonPath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--min-ms") && i + 1 < argc) {
+            minMs = std::stoi(argv[++i]);
+        }
+    }
+
+    // the boards' pieces are pointed at from the fixtures, which therefore never move
+    std::deque<Fixture> fixtures;
+    for (const char* fen : corpus) {
+        BoardState position;
+        if (BoardState::fromFen(fen, position)) {
+            fixtures.emplace_back(position);
+        }
+    }
+
+    struct Case {
+        std::string name;
+        size_t operations;
+        std::function<size_t()> pass;
+    };
+    std::vector<Case> cases;
+
+    GameStore store;
+    MoveBatch batch;
+    std::vector<uint8_t> expected;
+    buildMoveBatch(store, batch, expected);
+    std::vector<PendingMove> slotted;
+    for (const PendingMove& move : batch.moves()) {
+        slotted.push_back({ store.slot(move.game), move.from, move.to });
+    }
+    std::vector<uint8_t> valid(slotted.size()), plain(slotted.size());
+    size_t legalCount = validateMoves(store.legalMasks(), slotted.data(), slotted.size(), valid.data());
+    validatePlain(store.legalMasks(), slotted, plain.data());
+    batch.validate(store);
+    size_t disagreements = 0;
+    for (size_t i = 0; i < slotted.size(); i++) {
+        disagreements += valid[i] != plain[i] || valid[i] != expected[i] || batch.results()[i] != expected[i];
+    }
+    std::cout << "move batch: " << slotted.size() << " moves, " << legalCount << " legal, " << MoveBatch::kernel() << " kernel "
+        << (disagreements ? "disagrees on " + std::to_string(disagreements) + " of them" : std::string("agrees with a plain loop and the legal moves"))
+        << std::endl;
+
+    cases.push_back({ std::string("validateMoves ") + MoveBatch::kernel(), slotted.size(), [&store, &slotted, &valid] {
+        return validateMoves(store.legalMasks(), slotted.data(), slotted.size(), valid.data());
+    } });
+    cases.push_back({ "validateMoves plain loop", slotted.size(), [&store, &slotted, &plain] {
+        return validatePlain(store.legalMasks(), slotted, plain.data());
+    } });
+    cases.push_back({ "MoveBatch::validate", slotted.size(), [&store, &batch] {
+        return batch.validate(store).legal;
+    } });
+
+    const std::pair<const char*, Piece::PieceType::Type> pieces[] = {
+        { "Pawn", Piece::PieceType::PAWN }, { "Knight", Piece::PieceType::KNIGHT }, { "Bishop", Piece::PieceType::BISHOP },
+        { "Rook", Piece::PieceType::ROOK }, { "Queen", Piece::PieceType::QUEEN }, { "King", Piece::PieceType::KING },
+    };
+    for (const auto& piece : pieces) {
+        Piece::PieceType::Type type = piece.second;
+        cases.push_back({ std::string(piece.first) + "::validMoves", countPieces(fixtures, type),
+            [&fixtures, type] { return validMovesOf(fixtures, type); } });
+    }
+
+    cases.push_back({ "Player::attackingPieces", fixtures.size(), [&fixtures] {
+        size_t found = 0;
+        for (Fixture& fixture : fixtures) {
+            found += fixture.player.attackingPieces(fixture.state).size();
+        }
+        return found;
+    } });
+
+    size_t moveCount = 0;
+    for (const Fixture& fixture : fixtures) {
+        moveCount += fixture.moves.size();
+    }
+    cases.push_back({ "Player::putsKingInCheck", moveCount, [&fixtures] {
+        size_t found = 0;
+        for (Fixture& fixture : fixtures) {
+            for (const auto& move : fixture.moves) {
+                found += fixture.player.putsKingInCheck(fixture.state, move.first);
+            }
+        }
+        return found;
+    } });
+
+    cases.push_back({ "Player::legalMoves", fixtures.size(), [&fixtures] {
+        size_t found = 0;
+        for (Fixture& fixture : fixtures) {
+            found += fixture.player.legalMoves(fixture.state, nullptr).size();
+        }
+        return found;
+    } });
+
+    // a turn is a game set up from a snapshot plus one move; setting up alone is timed too so it can
+    // be taken off
+    std::vector<GameSnapshot> snapshots;
+    for (const Fixture& fixture : fixtures) {
+        snapshots.push_back(GameSnapshot::fromPosition(fixture.position));
+    }
+    cases.push_back({ "Game(snapshot)", fixtures.size(), [&snapshots] {
+        size_t plies = 0;
+        for (const GameSnapshot& snapshot : snapshots) {
+            Game game(snapshot);
+            plies += game.getPlies() + 1;
+        }
+        return plies;
+    } });
+    cases.push_back({ "Game::makeMove turn", fixtures.size(), [&snapshots, &fixtures] {
+        size_t played = 0;
+        for (size_t i = 0; i < snapshots.size(); i++) {
+            Fixture& fixture = fixtures[i];
+            Game game(snapshots[i]);
+            if (fixture.moves.empty()) {
+                continue;
+            }
+            // makeMove only needs the mover's colour and king square, which the fixture's player has
+            Player player = fixture.player;
+            Move move = fixture.moves.front().first;
+            game.makeMove(player, move, fixture.moves.front().second, game.getLastMove(), Piece::PieceType::QUEEN);
+            game.addMoveToHistory(move);
+            played++;
+        }
+        return played;
+    } });
+
+    // the replayed game's moves as the object board plays them
+    std::vector<std::pair<Move, PositionType::MoveType>> line;
+    BoardState replay = BoardState::startPosition();
+    for (const char* uci : operaGame) {
+        Move move(Position('8' - uci[1], uci[0] - 'a'), Position('8' - uci[3], uci[2] - 'a'));
+        EngineMove found = replay.findMove(move);
+        UndoInfo undo;
+        replay.makeMove(found, undo);
+        line.push_back({ move, found.mtype() });
+    }
+    const std::pair<const char*, Game::MoveUpdates> updates[] = {
+        { "full", Game::MoveUpdates::FULL }, { "incremental", Game::MoveUpdates::INCREMENTAL },
+    };
+    for (const auto& update : updates) {
+        Game::MoveUpdates mode = update.second;
+        cases.push_back({ std::string("Game::legalMoves ") + update.first, line.size(), [&line, mode] {
+            GameSnapshot start = GameSnapshot::fromPosition(BoardState::startPosition());
+            Game game(start);
+            game.setMoveUpdates(mode);
+            Player players[2];
+            for (Piece::Color color : { Piece::Color::WHITE, Piece::Color::BLACK }) {
+                int king = start.position.kingSquare(color);
+                Position kingPos(rowOf(king), colOf(king));
+                players[static_cast<int>(color)].setColor(color);
+                players[static_cast<int>(color)].setKingpos(kingPos);
+            }
+            size_t found = 0;
+            for (size_t ply = 0; ply < line.size(); ply++) {
+                Player& mover = players[ply % 2];
+                found += game.legalMoves(mover).size();
+                Move move = line[ply].first;
+                game.makeMove(mover, move, line[ply].second, game.getLastMove(), Piece::PieceType::QUEEN);
+                game.addMoveToHistory(move);
+            }
+            return found;
+        } });
+    }
+
+    std::vector<BenchmarkResult> results;
+    std::cout << std::left << std::setw(28) << "benchmark" << std::right << std::setw(12) << "ns/op" << std::setw(12) << "mean"
+        << std::setw(12) << "ops/pass" << std::endl;
+    for (const Case& c : cases) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        BenchmarkResult result = runCase(c.name, c.operations, c.pass, minMs);
+        results.push_back(result);
+        std::cout << std::left << std::setw(28) << result.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << result.nsPerOp << std::setw(12) << result.meanNsPerOp << std::setw(12) << result.operations << std::endl;
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        writeJson(out, results);
+        std::cout << "wrote " << jsonPath << std::endl;
+    }
+    return disagreements ? 1 : 0;
+}
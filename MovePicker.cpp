@@ -0,0 +1,232 @@
+#include "MovePicker.h"
+#include <algorithm>
+
+
+// indexed by Piece::PieceType::Type: PIECE, PAWN, KING, QUEEN, ROOK, KNIGHT, BISHOP
+static const int seeValues[7] = { 0, 100, 20000, 900, 500, 320, 330 };
+
+// cheapest attacker first when building an exchange
+static const Piece::PieceType::Type exchangeOrder[6] = {
+    Piece::PieceType::PAWN, Piece::PieceType::KNIGHT, Piece::PieceType::BISHOP,
+    Piece::PieceType::ROOK, Piece::PieceType::QUEEN, Piece::PieceType::KING
+};
+
+int staticExchange(const BoardState& board, EngineMove move) {
+    PositionType::MoveType mtype = move.mtype();
+    if (mtype == PositionType::MoveType::ENPASS || mtype == PositionType::MoveType::KCASTLE ||
+        mtype == PositionType::MoveType::QCASTLE) {
+        return 0;
+    }
+
+    int from = move.from();
+    int to = move.to();
+    int gain[32];
+    int d = 0;
+
+    Bitboard occ = board.occupied() ^ squareBB(from);
+    Piece::PieceType::Type attacker = typeOf(board.squares[from]);
+    gain[0] = seeValues[typeOf(board.squares[to])];
+    if (mtype == PositionType::MoveType::PROM) {
+        gain[0] += seeValues[move.promotion()] - seeValues[Piece::PieceType::PAWN];
+        attacker = move.promotion();
+    }
+
+    Piece::Color side = board.turn;
+    Bitboard bishops = board.byType[Piece::PieceType::BISHOP] | board.byType[Piece::PieceType::QUEEN];
+    Bitboard rooks = board.byType[Piece::PieceType::ROOK] | board.byType[Piece::PieceType::QUEEN];
+
+    while (d < 31) {
+        d++;
+        side = opposite(side);
+        gain[d] = seeValues[attacker] - gain[d - 1];  // score if the piece just moved gets taken
+        if (std::max(-gain[d - 1], gain[d]) < 0) {
+            break; // neither side can gain by continuing
+        }
+
+        // recomputed every step so sliders behind the pieces already used join in
+        Bitboard attackers = (board.attackersTo(to, occ) | (bishopAttacks(to, occ) & bishops) | (rookAttacks(to, occ) & rooks)) & occ;
+        Bitboard ours = attackers & board.byColor[colorIndex(side)];
+        if (!ours) {
+            break;
+        }
+        for (Piece::PieceType::Type type : exchangeOrder) {
+            Bitboard candidates = ours & board.byType[type];
+            if (candidates) {
+                occ ^= squareBB(lsb(candidates));
+                attacker = type;
+                break;
+            }
+        }
+    }
+
+    while (--d) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    }
+    return gain[0];
+}
+
+static bool isCapture(const BoardState& board, EngineMove move) {
+    return board.squares[move.to()] != NO_PIECE || move.mtype() == PositionType::MoveType::ENPASS;
+}
+
+MovePicker::MovePicker(const BoardState& board, EngineMove ttMove, const EngineMove* killers, EngineMove counterMove, const int (*history)[64])
+    : m_board(board), m_stage(Stage::TT_MOVE), m_capturesOnly(false), m_inCheck(board.inCheck()), m_ttMove(ttMove), m_refutations{ killers[0], killers[1], counterMove },
+    m_refutationIndex(0), m_history(history), m_current(0), m_badCount(0), m_badIndex(0) {
+    if (!board.isPseudoLegal(m_ttMove)) {
+        m_ttMove = EngineMove();
+    }
+}
+
+MovePicker::MovePicker(const BoardState& board, EngineMove ttMove)
+    : m_board(board), m_stage(Stage::TT_MOVE), m_capturesOnly(true), m_inCheck(board.inCheck()), m_ttMove(ttMove), m_refutationIndex(0),
+    m_history(nullptr), m_current(0), m_badCount(0), m_badIndex(0) {
+    bool tactical = isCapture(board, m_ttMove) || m_ttMove.mtype() == PositionType::MoveType::PROM;
+    if (!board.isPseudoLegal(m_ttMove) || (!tactical && !m_inCheck)) {
+        m_ttMove = EngineMove();
+    }
+}
+
+void MovePicker::scoreCaptures() {
+    // most valuable victim first, least valuable attacker breaking ties
+    for (int i = 0; i < m_list.size; i++) {
+        EngineMove move = m_list.moves[i];
+        int victim = move.mtype() == PositionType::MoveType::ENPASS ? Piece::PieceType::PAWN : typeOf(m_board.squares[move.to()]);
+        int score = seeValues[victim] * 8 - seeValues[typeOf(m_board.squares[move.from()])] / 100;
+        if (move.mtype() == PositionType::MoveType::PROM) {
+            score += seeValues[move.promotion()] * 8;
+        }
+        m_scores[i] = score;
+    }
+}
+
+void MovePicker::scoreQuiets() {
+    for (int i = 0; i < m_list.size; i++) {
+        EngineMove move = m_list.moves[i];
+        m_scores[i] = m_history[move.from()][move.to()];
+    }
+}
+
+void MovePicker::scoreEvasions() {
+    // captures of the checker before moving away or blocking, which go by history when there is one
+    for (int i = 0; i < m_list.size; i++) {
+        EngineMove move = m_list.moves[i];
+        if (isCapture(m_board, move)) {
+            int victim = move.mtype() == PositionType::MoveType::ENPASS ? Piece::PieceType::PAWN : typeOf(m_board.squares[move.to()]);
+            m_scores[i] = (1 << 24) + seeValues[victim] * 8 - seeValues[typeOf(m_board.squares[move.from()])] / 100;
+        }
+        else {
+            m_scores[i] = m_history ? m_history[move.from()][move.to()] : 0;
+        }
+    }
+}
+
+// selection sort one step at a time, cutoffs usually come before the list is sorted
+EngineMove MovePicker::pickBest() {
+    int best = m_current;
+    for (int i = m_current + 1; i < m_list.size; i++) {
+        if (m_scores[i] > m_scores[best]) {
+            best = i;
+        }
+    }
+    std::swap(m_list.moves[m_current], m_list.moves[best]);
+    std::swap(m_scores[m_current], m_scores[best]);
+    return m_list.moves[m_current++];
+}
+
+EngineMove MovePicker::next() {
+    while (true) {
+        switch (m_stage) {
+        case Stage::TT_MOVE:
+            m_stage = m_inCheck ? Stage::GEN_EVASIONS : Stage::GEN_CAPTURES;
+            if (!m_ttMove.isNull()) {
+                return m_ttMove;
+            }
+            break;
+
+        case Stage::GEN_CAPTURES:
+            m_list.size = 0;
+            generateMoves(m_board, GenType::CAPTURES, m_list);
+            scoreCaptures();
+            m_current = 0;
+            m_stage = Stage::GOOD_CAPTURES;
+            break;
+
+        case Stage::GOOD_CAPTURES:
+            while (m_current < m_list.size) {
+                EngineMove move = pickBest();
+                if (move == m_ttMove) {
+                    continue;
+                }
+                // only taking a cheaper piece can lose material, so only those pay for an exchange
+                bool cheaperVictim = seeValues[typeOf(m_board.squares[move.to()])] < seeValues[typeOf(m_board.squares[move.from()])];
+                if (cheaperVictim && move.mtype() != PositionType::MoveType::ENPASS && staticExchange(m_board, move) < 0) {
+                    m_badCaptures[m_badCount++] = move;
+                    continue;
+                }
+                return move;
+            }
+            m_stage = m_capturesOnly ? Stage::DONE : Stage::KILLERS;
+            break;
+
+        case Stage::KILLERS:
+            while (m_refutationIndex < 3) {
+                EngineMove move = m_refutations[m_refutationIndex++];
+                if (move.isNull() || move == m_ttMove || isCapture(m_board, move) || !m_board.isPseudoLegal(move) ||
+                    std::find(m_refutations, m_refutations + m_refutationIndex - 1, move) != m_refutations + m_refutationIndex - 1) {
+                    continue;
+                }
+                return move;
+            }
+            m_stage = Stage::GEN_QUIETS;
+            break;
+
+        case Stage::GEN_QUIETS:
+            m_list.size = 0;
+            generateMoves(m_board, GenType::QUIETS, m_list);
+            scoreQuiets();
+            m_current = 0;
+            m_stage = Stage::QUIETS;
+            break;
+
+        case Stage::QUIETS:
+            while (m_current < m_list.size) {
+                EngineMove move = pickBest();
+                if (move == m_ttMove || move == m_refutations[0] || move == m_refutations[1] || move == m_refutations[2]) {
+                    continue;
+                }
+                return move;
+            }
+            m_stage = Stage::BAD_CAPTURES;
+            break;
+
+        case Stage::BAD_CAPTURES:
+            if (m_badIndex < m_badCount) {
+                return m_badCaptures[m_badIndex++];
+            }
+            m_stage = Stage::DONE;
+            break;
+
+        case Stage::GEN_EVASIONS:
+            m_list.size = 0;
+            generateMoves(m_board, GenType::EVASIONS, m_list);
+            scoreEvasions();
+            m_current = 0;
+            m_stage = Stage::EVASIONS;
+            break;
+
+        case Stage::EVASIONS:
+            while (m_current < m_list.size) {
+                EngineMove move = pickBest();
+                if (move == m_ttMove) {
+                    continue;
+                }
+                return move;
+            }
+            m_stage = Stage::DONE;
+            break;
+
+        case Stage::DONE:
+            return EngineMove();
+        }
+    }
+}
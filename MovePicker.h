@@ -0,0 +1,48 @@
+#pragma once
+#include "BoardState.h"
+
+// Static exchange evaluation: material balance in centipawns for the side to move after every
+// recapture on the destination square, with each side free to stop capturing
+int staticExchange(const BoardState& board, EngineMove move);
+
+// Hands out moves one at a time in stages so a cutoff early in the list skips the rest of the
+// work: the table move, captures by MVV-LVA that do not lose material, killers and the counter
+// move, quiet moves by history, then losing captures. Quiet moves are only generated once the
+// captures and killers are exhausted. In check there is one stage after the table move instead:
+// the evasions, captures first and then quiet moves by history.
+class MovePicker {
+public:
+	// main search
+	MovePicker(const BoardState& board, EngineMove ttMove, const EngineMove* killers, EngineMove counterMove, const int (*history)[64]);
+
+	// quiescence search: the table move and captures that do not lose material only, or every
+	// evasion when in check
+	MovePicker(const BoardState& board, EngineMove ttMove);
+
+	// returns a null move once every stage is done
+	EngineMove next();
+
+private:
+	enum class Stage { TT_MOVE, GEN_CAPTURES, GOOD_CAPTURES, KILLERS, GEN_QUIETS, QUIETS, BAD_CAPTURES, GEN_EVASIONS, EVASIONS, DONE };
+
+	void scoreCaptures();
+	void scoreQuiets();
+	void scoreEvasions();
+	EngineMove pickBest();
+
+	const BoardState& m_board;
+	Stage m_stage;
+	bool m_capturesOnly;
+	bool m_inCheck;
+	EngineMove m_ttMove;
+	EngineMove m_refutations[3];  // killer 1, killer 2, counter move
+	int m_refutationIndex;
+	const int (*m_history)[64];
+
+	MoveList m_list;
+	int m_scores[256];
+	int m_current;
+	EngineMove m_badCaptures[256];
+	int m_badCount;
+	int m_badIndex;
+};
@@ -0,0 +1,106 @@
+#include "MoveValidator.h"
+#include <chrono>
+#include "Metrics.h"
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+
+static inline uint8_t validateOne(const LegalMask* masks, const PendingMove& move) {
+    return static_cast<uint8_t>((masks[move.game].destinations[move.from] >> move.to) & 1);
+}
+
+// index of a move's origin square in the masks taken as one flat array of bitboards
+static inline size_t maskIndex(const PendingMove& move) {
+    return static_cast<size_t>(move.game) * 64 + move.from;
+}
+
+size_t validateMoves(const LegalMask* masks, const PendingMove* moves, size_t count, uint8_t* valid) {
+    size_t legal = 0;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const long long* base = reinterpret_cast<const long long*>(masks);
+    // a PendingMove is 8 bytes, game in the low half then from and to, so four load as one vector
+    // and the gather index and shift come out with vector arithmetic alone
+    const __m256i low32 = _mm256_set1_epi64x(0xffffffff);
+    const __m256i square = _mm256_set1_epi64x(63);
+    for (; i + 4 <= count; i += 4) {
+        __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(moves + i));
+        __m256i game = _mm256_and_si256(packed, low32);
+        __m256i from = _mm256_and_si256(_mm256_srli_epi64(packed, 32), square);
+        __m256i to = _mm256_and_si256(_mm256_srli_epi64(packed, 40), square);
+        __m256i index = _mm256_add_epi64(_mm256_slli_epi64(game, 6), from);
+        __m256i destinations = _mm256_i64gather_epi64(base, index, 8);
+        // bring each move's bit to the top of its lane, where movemask picks it up
+        __m256i bit = _mm256_slli_epi64(_mm256_srlv_epi64(destinations, to), 63);
+        int found = _mm256_movemask_pd(_mm256_castsi256_pd(bit));
+        for (int lane = 0; lane < 4; lane++) {
+            valid[i + lane] = (found >> lane) & 1;
+            legal += valid[i + lane];
+        }
+    }
+#elif defined(__SSE4_1__)
+    const long long* base = reinterpret_cast<const long long*>(masks);
+    for (; i + 2 <= count; i += 2) {
+        const PendingMove* m = moves + i;
+        __m128i destinations = _mm_set_epi64x(base[maskIndex(m[1])], base[maskIndex(m[0])]);
+        __m128i bits = _mm_set_epi64x(static_cast<long long>(squareBB(m[1].to)), static_cast<long long>(squareBB(m[0].to)));
+        __m128i missing = _mm_cmpeq_epi64(_mm_and_si128(destinations, bits), _mm_setzero_si128());
+        int found = ~_mm_movemask_pd(_mm_castsi128_pd(missing)) & 3;
+        valid[i] = found & 1;
+        valid[i + 1] = found >> 1;
+        legal += (found & 1) + (found >> 1);
+    }
+#endif
+    for (; i < count; i++) {
+        valid[i] = validateOne(masks, moves[i]);
+        legal += valid[i];
+    }
+    return legal;
+}
+
+void MoveBatch::add(GameId game, int from, int to) {
+    m_moves.push_back({ game, static_cast<uint8_t>(from & 63), static_cast<uint8_t>(to & 63) });
+}
+
+void MoveBatch::clear() {
+    m_moves.clear();
+    m_results.clear();
+}
+
+const ValidationStats& MoveBatch::validate(GameStore& store) {
+    m_results.resize(m_moves.size());
+    m_slotted.resize(m_moves.size());
+    size_t legal;
+    auto start = std::chrono::steady_clock::now();
+    {
+        METRICS_TIMER(Stage::MOVE_BATCH);
+        for (size_t i = 0; i < m_moves.size(); i++) {
+            m_slotted[i] = { store.slot(m_moves[i].game), m_moves[i].from, m_moves[i].to };
+        }
+        legal = validateMoves(store.legalMasks(), m_slotted.data(), m_slotted.size(), m_results.data());
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    METRICS_ADD(Counter::MOVES_VALIDATED, m_moves.size());
+    METRICS_ADD(Counter::MOVES_REJECTED, m_moves.size() - legal);
+
+    m_last.batches = 1;
+    m_last.moves = m_moves.size();
+    m_last.legal = legal;
+    m_last.nanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    m_total.batches++;
+    m_total.moves += m_last.moves;
+    m_total.legal += m_last.legal;
+    m_total.nanos += m_last.nanos;
+    return m_last;
+}
+
+const char* MoveBatch::kernel() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE4_1__)
+    return "sse4.1";
+#else
+    return "scalar";
+#endif
+}
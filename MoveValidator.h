@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "GameStore.h"
+
+// a move sent by a client, not yet known to be legal
+struct PendingMove {
+	GameId game;
+	uint8_t from;
+	uint8_t to;
+};
+
+static_assert(sizeof(PendingMove) == 8, "the AVX2 kernel loads four pending moves as one vector");
+
+struct ValidationStats {
+	size_t batches = 0;
+	size_t moves = 0;
+	size_t legal = 0;
+	uint64_t nanos = 0;
+
+	double movesPerSecond() const { return nanos ? moves * 1e9 / nanos : 0.0; }
+};
+
+// Client moves collected across games and checked together against the store's legal masks: one
+// gather of the origin square's destinations and one bit test per move, four moves per AVX2 step
+// or two per SSE4.1 step, plain loads when neither is compiled in. Only the squares are checked;
+// the promotion piece and move type are settled when the move is played. Masks are kept by live
+// slot, so the batch is first given slots in place of game IDs, waking any compacted game it names.
+class MoveBatch {
+public:
+	void add(GameId game, int from, int to);
+	void clear();
+	size_t size() const { return m_moves.size(); }
+	const std::vector<PendingMove>& moves() const { return m_moves; }
+
+	// fills results() with 1 for each legal move, 0 otherwise, in the order they were added; the
+	// batch is also recorded as the MOVE_BATCH stage and the validated and rejected move counters
+	const ValidationStats& validate(GameStore& store);
+
+	const std::vector<uint8_t>& results() const { return m_results; }
+	const ValidationStats& lastBatch() const { return m_last; }
+	// every batch validated so far
+	const ValidationStats& total() const { return m_total; }
+
+	// the instruction set the kernel was compiled for: "avx2", "sse4.1" or "scalar"
+	static const char* kernel();
+
+private:
+	std::vector<PendingMove> m_moves;
+	std::vector<PendingMove> m_slotted;   // m_moves with each game's slot for its ID
+	std::vector<uint8_t> m_results;
+	ValidationStats m_last;
+	ValidationStats m_total;
+};
+
+// checks count moves against masks indexed by the moves' game field, writing 1 or 0 to valid;
+// returns the number legal
+size_t validateMoves(const LegalMask* masks, const PendingMove* moves, size_t count, uint8_t* valid);
@@ -0,0 +1,59 @@
+#include "PackedGame.h"
+
+
+PackedPosition PackedPosition::pack(const BoardState& board) {
+    PackedPosition packed{};
+    packed.occupied = board.occupied();
+    Bitboard occupied = packed.occupied;
+    for (int i = 0; occupied && i < 32; i++) {
+        packed.pieces[i / 2] |= static_cast<uint8_t>(board.squares[popLsb(occupied)] << (i % 2 * 4));
+    }
+    for (int i = 0; i < 4; i++) {
+        packed.rookFiles |= static_cast<uint16_t>(colOf(board.castlingRooks[i]) << (i * 3));
+    }
+    packed.castling = board.castling;
+    packed.epSquare = board.epSquare;
+    packed.state = static_cast<uint8_t>((board.turn == Piece::Color::BLACK) | static_cast<int>(board.variant) << 1 | board.checks[0] << 3 | board.checks[1] << 5);
+    return packed;
+}
+
+BoardState PackedPosition::unpack() const {
+    BoardState board;
+    Bitboard remaining = occupied;
+    for (int i = 0; remaining && i < 32; i++) {
+        board.putPiece((pieces[i / 2] >> (i % 2 * 4)) & 15, popLsb(remaining));
+    }
+    // rights 0 and 1 are white's, on the first rank
+    for (int i = 0; i < 4; i++) {
+        board.castlingRooks[i] = static_cast<int8_t>(squareOf(i < 2 ? 7 : 0, (rookFiles >> (i * 3)) & 7));
+    }
+    board.castling = castling;
+    board.epSquare = epSquare;
+    board.turn = (state & 1) ? Piece::Color::BLACK : Piece::Color::WHITE;
+    board.variant = static_cast<Variant>((state >> 1) & 3);
+    board.checks[0] = (state >> 3) & 3;
+    board.checks[1] = (state >> 5) & 3;
+    board.key = board.computeKey();
+    return board;
+}
+
+bool packMove(const BoardState& position, EngineMove move, uint8_t& index) {
+    MoveList list;
+    generateMoves(position, GenType::ALL, list);
+    // moves given to a store are legal but may carry a promotion piece the generator leaves unset
+    for (int i = 0; i < list.size; i++) {
+        EngineMove generated = list.moves[i];
+        if (generated == move || (generated.from() == move.from() && generated.to() == move.to() && generated.mtype() == move.mtype() &&
+            (generated.mtype() != PositionType::MoveType::PROM || generated.promotion() == move.promotion()))) {
+            index = static_cast<uint8_t>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+EngineMove unpackMove(const BoardState& position, uint8_t index) {
+    MoveList list;
+    generateMoves(position, GenType::ALL, list);
+    return index < list.size ? list.moves[index] : EngineMove();
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include "BoardState.h"
+
+// A position in 32 bytes, for games that sit idle: the occupied squares, then a 4-bit piece code for
+// each of them in square order, then the rights, en passant square, side to move, variant and
+// three-check counts. The key and evaluation are recomputed when it is unpacked. Only the first 32
+// pieces are kept, which is every piece of any position reachable in a game.
+struct PackedPosition {
+	uint64_t occupied;
+	uint8_t pieces[16];   // two codes per byte, low nibble first
+	uint16_t rookFiles;   // file of each castling right's rook, three bits each by castlingIndex
+	uint8_t castling;
+	int8_t epSquare;
+	uint8_t state;        // side to move in bit 0, variant in bits 1-2, checks given by white in 3-4 and black in 5-6
+
+	static PackedPosition pack(const BoardState& board);
+	BoardState unpack() const;
+
+	// false when the position had more pieces than are kept
+	bool complete() const { return popCount(occupied) <= 32; }
+};
+
+static_assert(sizeof(PackedPosition) == 32, "packed positions are meant to fit half a cache line");
+
+// A played move as one byte, its index among the pseudo-legal moves generateMoves gives for the
+// position it was played in, which fit a MoveList; replaying a game then costs a generation and a
+// makeMove per ply, with no legality checks. The order is only fixed within one build of the
+// engine, so packed moves are for keeping in memory, not for files. False, leaving index alone, if the
+// generator has no such move.
+bool packMove(const BoardState& position, EngineMove move, uint8_t& index);
+// the move a byte from packMove stands for, a null move if the position has no such index
+EngineMove unpackMove(const BoardState& position, uint8_t index);
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "AttackTables.h"
+
+// the rules a game is played under; every BoardState carries its own
+enum class Variant : uint8_t { STANDARD, CHESS960, KING_OF_THE_HILL, THREE_CHECK };
+
+// Compile-time rules policies. The generators and game-end checks are templates over one of these
+// and test its constants with if constexpr, so standard chess compiles to the code it always had
+// and a variant only pays for the rules it changes. A position's Variant is turned into its policy
+// once, where a generator is entered, rather than tested inside the loops.
+struct StandardRules {
+	static constexpr Variant variant = Variant::STANDARD;
+	// king and rooks may start on any files of the back rank; castling still ends with them on the
+	// files they reach in standard chess
+	static constexpr bool anyCastlingFiles = false;
+	// a king reaching one of these squares wins
+	static constexpr Bitboard hill = 0;
+	// giving this many checks wins, never when 0
+	static constexpr int checksToWin = 0;
+};
+
+struct Chess960Rules : StandardRules {
+	static constexpr Variant variant = Variant::CHESS960;
+	static constexpr bool anyCastlingFiles = true;
+};
+
+struct KingOfTheHillRules : StandardRules {
+	static constexpr Variant variant = Variant::KING_OF_THE_HILL;
+	// d5, e5, d4 and e4
+	static constexpr Bitboard hill = squareBB(squareOf(3, 3)) | squareBB(squareOf(3, 4)) | squareBB(squareOf(4, 3)) | squareBB(squareOf(4, 4));
+};
+
+struct ThreeCheckRules : StandardRules {
+	static constexpr Variant variant = Variant::THREE_CHECK;
+	static constexpr int checksToWin = 3;
+};
+
+// Castling is written as the king's two-square move when king and rook stand where they do in
+// standard chess, and as the king taking its own rook otherwise, which no other move can be; a
+// king that castles onto a square it could also step to stays unambiguous that way.
+constexpr int castlingTarget(int king, int rook) {
+	bool kingSide = rook > king;
+	return colOf(king) == 4 && colOf(rook) == (kingSide ? 7 : 0) ? king + (kingSide ? 2 : -2) : rook;
+}
+
+// names used on the command line and by the server
+inline const char* const VARIANT_NAMES[] = { "standard", "chess960", "kingofthehill", "threecheck" };
+
+inline const char* variantName(Variant variant) {
+	return VARIANT_NAMES[static_cast<int>(variant)];
+}
+
+// false for a name that is not one of VARIANT_NAMES
+inline bool variantFromName(const char* name, Variant& out) {
+	for (int i = 0; i < 4; i++) {
+		if (std::strcmp(name, VARIANT_NAMES[i]) == 0) {
+			out = static_cast<Variant>(i);
+			return true;
+		}
+	}
+	return false;
+}
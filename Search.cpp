@@ -0,0 +1,488 @@
+#include "Search.h"
+#include <algorithm>
+#include "Evaluation.h"
+#include "MovePicker.h"
+
+
+// mate scores are stored relative to the node rather than the root
+static int scoreToTT(int score, int ply) {
+    return score >= MATE_BOUND ? score + ply : score <= -MATE_BOUND ? score - ply : score;
+}
+
+static int scoreFromTT(int score, int ply) {
+    return score >= MATE_BOUND ? score - ply : score <= -MATE_BOUND ? score + ply : score;
+}
+
+static bool ttCutoff(const TTData& entry, int score, int alpha, int beta) {
+    return entry.bound == Bound::EXACT ||
+        (entry.bound == Bound::LOWER && score >= beta) ||
+        (entry.bound == Bound::UPPER && score <= alpha);
+}
+
+// table results are exact, so they score like a mate found by search
+static int tablebaseScore(const TablebaseProbe& probe, int ply) {
+    int mate = MATE_SCORE - ply - probe.plies;
+    return probe.wdl > 0 ? mate : probe.wdl < 0 ? -mate : 0;
+}
+
+static bool isQuiet(EngineMove move) {
+    PositionType::MoveType mtype = move.mtype();
+    return mtype != PositionType::MoveType::CAPT && mtype != PositionType::MoveType::ENPASS && mtype != PositionType::MoveType::PROM;
+}
+
+Searcher::Searcher(TranspositionTable* tt, int threadIndex)
+    : m_tt(tt), m_tablebase(nullptr), m_threadIndex(threadIndex), m_ttProbes(0), m_ttHits(0), m_stop(false), m_nodes(0), m_pvLength{} {
+    if (m_tt == nullptr) {
+        m_ownedTT = std::make_unique<TranspositionTable>(16);
+        m_tt = m_ownedTT.get();
+    }
+}
+
+void Searcher::stop() {
+    m_stop = true;
+}
+
+uint64_t Searcher::nodes() const {
+    return m_nodes;
+}
+
+void Searcher::setTablebase(const Tablebase* tablebase) {
+    m_tablebase = tablebase;
+}
+
+int64_t Searcher::elapsedMs() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+bool Searcher::outOfBudget() {
+    if (m_stop) {
+        return true;
+    }
+    // the clock is only read every 1024 nodes
+    if ((m_nodes & 1023) == 0) {
+        if ((m_limits.maxNodes && m_nodes >= m_limits.maxNodes) ||
+            (m_limits.moveTimeMs && elapsedMs() >= m_limits.moveTimeMs)) {
+            m_stop = true;
+        }
+    }
+    return m_stop;
+}
+
+SearchResult Searcher::search(const BoardState& root, const SearchLimits& limits) {
+    // helpers are only stopped by their ParallelSearcher, which also stops the ones that already
+    // finished on their own, so they start clear; the main thread keeps a stop() sent before it started
+    if (m_threadIndex != 0) {
+        m_stop = false;
+    }
+    m_board = root;
+    m_limits = limits;
+    m_nodes = 0;
+    m_ttProbes = 0;
+    m_ttHits = 0;
+    m_start = std::chrono::steady_clock::now();
+    std::fill(&m_killers[0][0], &m_killers[0][0] + (MAX_PLY + 1) * 2, EngineMove());
+    std::fill(&m_history[0][0][0], &m_history[0][0][0] + 2 * 64 * 64, 0);
+    std::fill(&m_counterMoves[0][0], &m_counterMoves[0][0] + 64 * 64, EngineMove());
+    // a shared table is aged by its owner, once per logical search rather than per thread
+    if (m_ownedTT) {
+        m_tt->newSearch();
+    }
+
+    SearchResult result;
+    m_rootMoves.size = 0;
+    generateLegalMoves(m_board, m_rootMoves);
+    if (m_rootMoves.size == 0 || m_board.variantLoss()) {
+        m_stop = false;
+        result.score = m_board.inCheck() || m_board.variantLoss() ? -MATE_SCORE : 0;
+        return result;
+    }
+    result.bestMove = m_rootMoves.moves[0];
+
+    // a covered root needs no search, the table's line is played out for the principal variation
+    EngineMove tableMove;
+    TablebaseProbe probe;
+    if (m_tablebase && m_tablebase->probeRoot(m_board, tableMove, probe)) {
+        result.bestMove = tableMove;
+        result.score = tablebaseScore(probe, 0);
+        result.tablebase = true;
+        BoardState line = m_board;
+        while (!tableMove.isNull() && result.pv.size() < MAX_PLY) {
+            result.pv.push_back(tableMove);
+            UndoInfo undo;
+            line.makeMove(tableMove, undo);
+            if (!m_tablebase->probeRoot(line, tableMove, probe)) {
+                break;
+            }
+        }
+        m_stop = false;
+        result.timeMs = elapsedMs();
+        return result;
+    }
+
+    // odd helper threads start one ply deeper so the threads spread over two depths
+    int maxDepth = std::min(limits.maxDepth, MAX_PLY - 1);
+    for (int depth = 1 + (m_threadIndex & 1); depth <= maxDepth; depth++) {
+        // aspiration window around the previous score, widened on every fail
+        int delta = 25;
+        int alpha = -INF_SCORE, beta = INF_SCORE;
+        if (depth >= 4 && std::abs(result.score) < MATE_BOUND) {
+            alpha = std::max(result.score - delta, -INF_SCORE);
+            beta = std::min(result.score + delta, INF_SCORE);
+        }
+
+        int score;
+        while (true) {
+            score = searchRoot(depth, alpha, beta);
+            if (m_stop) {
+                break;
+            }
+            if (score <= alpha) {
+                alpha = std::max(score - delta, -INF_SCORE);
+            }
+            else if (score >= beta) {
+                beta = std::min(score + delta, INF_SCORE);
+            }
+            else {
+                break;
+            }
+            delta *= 2;
+        }
+        if (m_stop) {
+            break;
+        }
+
+        result.score = score;
+        result.depth = depth;
+        result.bestMove = m_pv[0][0];
+        result.pv.assign(m_pv[0], m_pv[0] + m_pvLength[0]);
+
+        // keep the best move in front for the next iteration
+        EngineMove* best = std::find(m_rootMoves.begin(), m_rootMoves.end(), result.bestMove);
+        std::rotate(m_rootMoves.begin(), best, best + 1);
+
+        if (std::abs(score) >= MATE_BOUND || (limits.moveTimeMs && elapsedMs() >= limits.moveTimeMs / 2)) {
+            break; // another iteration would not finish in time
+        }
+    }
+
+    // the flag is cleared on the way out, so a stop() that arrives before the search starts still ends it
+    m_stop = false;
+    m_tt->addProbeStats(m_ttProbes, m_ttHits);
+    result.nodes = m_nodes;
+    result.timeMs = elapsedMs();
+    return result;
+}
+
+int Searcher::searchRoot(int depth, int alpha, int beta) {
+    int bestScore = -INF_SCORE;
+    m_pvLength[0] = 0;
+
+    for (EngineMove move : m_rootMoves) {
+        UndoInfo undo;
+        m_board.makeMove(move, undo);
+        m_nodes++;
+        m_moveStack[0] = move;
+
+        int score;
+        if (bestScore == -INF_SCORE) {
+            score = -negamax(depth - 1, 1, -beta, -alpha);
+        }
+        else {
+            score = -negamax(depth - 1, 1, -alpha - 1, -alpha);
+            if (score > alpha && score < beta) {
+                score = -negamax(depth - 1, 1, -beta, -alpha);
+            }
+        }
+        m_board.unmakeMove(undo);
+
+        if (m_stop) {
+            return bestScore;
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            m_pv[0][0] = move;
+            std::copy(m_pv[1], m_pv[1] + m_pvLength[1], m_pv[0] + 1);
+            m_pvLength[0] = m_pvLength[1] + 1;
+            if (score > alpha) {
+                alpha = score;
+            }
+            if (alpha >= beta) {
+                break;
+            }
+        }
+    }
+    return bestScore;
+}
+
+int Searcher::negamax(int depth, int ply, int alpha, int beta) {
+    m_pvLength[ply] = 0;
+    if (m_board.variantLoss()) {
+        return -MATE_SCORE + ply;
+    }
+    bool inCheck = m_board.inCheck();
+    if (inCheck) {
+        depth++;  // check extension
+    }
+    if (depth <= 0 || ply >= MAX_PLY) {
+        return quiescence(ply, alpha, beta);
+    }
+    if (outOfBudget()) {
+        return 0;
+    }
+
+    bool pvNode = beta - alpha > 1;
+    int alphaOrig = alpha;
+    EngineMove ttMove;
+    TTData entry;
+    m_ttProbes++;
+    if (m_tt->probe(m_board.key, entry)) {
+        m_ttHits++;
+        ttMove = entry.move;
+        int ttScore = scoreFromTT(entry.score, ply);
+        if (!pvNode && entry.depth >= depth && ttCutoff(entry, ttScore, alpha, beta)) {
+            return ttScore;
+        }
+    }
+
+    if (m_tablebase && popCount(m_board.occupied()) <= m_tablebase->maxPieces()) {
+        TablebaseProbe probe;
+        if (m_tablebase->probe(m_board, probe)) {
+            return tablebaseScore(probe, ply);
+        }
+    }
+
+    Piece::Color us = m_board.turn;
+    EngineMove previous = m_moveStack[ply - 1];
+    EngineMove counterMove = previous.isNull() ? EngineMove() : m_counterMoves[previous.from()][previous.to()];
+    MovePicker picker(m_board, ttMove, m_killers[ply], counterMove, m_history[colorIndex(us)]);
+
+    int bestScore = -INF_SCORE;
+    EngineMove bestMove;
+    int legalMoves = 0;
+    EngineMove quietsTried[256];
+    int quietCount = 0;
+    for (EngineMove move = picker.next(); !move.isNull(); move = picker.next()) {
+        UndoInfo undo;
+        m_board.makeMove(move, undo);
+        if (m_board.isSquareAttacked(m_board.kingSquare(us), m_board.turn)) {
+            m_board.unmakeMove(undo);
+            continue;
+        }
+        m_nodes++;
+        legalMoves++;
+        m_moveStack[ply] = move;
+
+        int score;
+        if (legalMoves == 1) {
+            score = -negamax(depth - 1, ply + 1, -beta, -alpha);
+        }
+        else {
+            // principal variation search: prove the move is worse with a null window first
+            score = -negamax(depth - 1, ply + 1, -alpha - 1, -alpha);
+            if (score > alpha && score < beta) {
+                score = -negamax(depth - 1, ply + 1, -beta, -alpha);
+            }
+        }
+        m_board.unmakeMove(undo);
+
+        if (m_stop) {
+            return 0;
+        }
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = move;
+            if (score > alpha) {
+                alpha = score;
+                m_pv[ply][0] = move;
+                std::copy(m_pv[ply + 1], m_pv[ply + 1] + m_pvLength[ply + 1], m_pv[ply] + 1);
+                m_pvLength[ply] = m_pvLength[ply + 1] + 1;
+            }
+            if (alpha >= beta) {
+                if (isQuiet(move)) {
+                    updateQuietStats(move, ply, depth, quietsTried, quietCount);
+                }
+                break;
+            }
+        }
+        if (isQuiet(move)) {
+            quietsTried[quietCount++] = move;
+        }
+    }
+
+    if (legalMoves == 0) {
+        bestScore = inCheck ? -MATE_SCORE + ply : 0;  // checkmate or stalemate
+    }
+
+    Bound bound = bestScore >= beta ? Bound::LOWER : (bestScore > alphaOrig ? Bound::EXACT : Bound::UPPER);
+    m_tt->store(m_board.key, bestMove, scoreToTT(bestScore, ply), depth, bound);
+    return bestScore;
+}
+
+// a quiet move that caused a cutoff becomes a killer and the counter to the previous move; history
+// rewards it and penalises the quiet moves searched before it
+void Searcher::updateQuietStats(EngineMove move, int ply, int depth, const EngineMove* quietsTried, int quietCount) {
+    if (m_killers[ply][0] != move) {
+        m_killers[ply][1] = m_killers[ply][0];
+        m_killers[ply][0] = move;
+    }
+    EngineMove previous = m_moveStack[ply - 1];
+    if (!previous.isNull()) {
+        m_counterMoves[previous.from()][previous.to()] = move;
+    }
+
+    int (*history)[64] = m_history[colorIndex(m_board.turn)];
+    int bonus = std::min(depth * depth, 400);
+    auto update = [history](EngineMove quiet, int delta) {
+        // scaled so entries stay within +-16384 however long the search runs
+        int& entry = history[quiet.from()][quiet.to()];
+        entry += delta - entry * std::abs(delta) / 16384;
+    };
+    update(move, bonus);
+    for (int i = 0; i < quietCount; i++) {
+        update(quietsTried[i], -bonus);
+    }
+}
+
+int Searcher::quiescence(int ply, int alpha, int beta) {
+    m_pvLength[ply] = 0;
+    if (m_board.variantLoss()) {
+        return -MATE_SCORE + ply;
+    }
+    if (outOfBudget()) {
+        return 0;
+    }
+
+    bool pvNode = beta - alpha > 1;
+    int alphaOrig = alpha;
+    TTData entry;
+    m_ttProbes++;
+    bool ttHit = m_tt->probe(m_board.key, entry);
+    if (ttHit) {
+        m_ttHits++;
+        int ttScore = scoreFromTT(entry.score, ply);
+        if (!pvNode && ttCutoff(entry, ttScore, alpha, beta)) {
+            return ttScore;
+        }
+    }
+
+    // in check the side to move cannot stand pat: every evasion is searched and having none is mate
+    bool inCheck = m_board.inCheck();
+    if (ply >= MAX_PLY) {
+        return evaluate(m_board);
+    }
+    if (!inCheck) {
+        int standPat = evaluate(m_board);
+        if (standPat >= beta) {
+            return standPat;
+        }
+        if (standPat > alpha) {
+            alpha = standPat;
+        }
+    }
+
+    // only captures, en passant and queen promotions that do not lose material are searched until
+    // the position is quiet
+    MovePicker picker(m_board, ttHit ? entry.move : EngineMove());
+
+    Piece::Color us = m_board.turn;
+    EngineMove bestMove;
+    int legalMoves = 0;
+    for (EngineMove move = picker.next(); !move.isNull(); move = picker.next()) {
+        UndoInfo undo;
+        m_board.makeMove(move, undo);
+        if (m_board.isSquareAttacked(m_board.kingSquare(us), m_board.turn)) {
+            m_board.unmakeMove(undo);
+            continue;
+        }
+        legalMoves++;
+        m_nodes++;
+        int score = -quiescence(ply + 1, -beta, -alpha);
+        m_board.unmakeMove(undo);
+
+        if (m_stop) {
+            return 0;
+        }
+        if (score > alpha) {
+            alpha = score;
+            bestMove = move;
+            if (alpha >= beta) {
+                break;
+            }
+        }
+    }
+
+    if (inCheck && legalMoves == 0) {
+        return -MATE_SCORE + ply;
+    }
+
+    Bound bound = alpha >= beta ? Bound::LOWER : (alpha > alphaOrig ? Bound::EXACT : Bound::UPPER);
+    m_tt->store(m_board.key, bestMove, scoreToTT(alpha, ply), 0, bound);
+    return alpha;
+}
+
+ParallelSearcher::ParallelSearcher(TranspositionTable& tt, int threads) : m_tt(tt), m_tablebase(nullptr) {
+    setThreads(threads);
+}
+
+void ParallelSearcher::setThreads(int threads) {
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_searchers.clear();
+    for (int i = 0; i < threads; i++) {
+        m_searchers.push_back(std::make_unique<Searcher>(&m_tt, i));
+        m_searchers.back()->setTablebase(m_tablebase);
+    }
+}
+
+void ParallelSearcher::setTablebase(const Tablebase* tablebase) {
+    m_tablebase = tablebase;
+    for (auto& searcher : m_searchers) {
+        searcher->setTablebase(tablebase);
+    }
+}
+
+int ParallelSearcher::threads() const {
+    return static_cast<int>(m_searchers.size());
+}
+
+void ParallelSearcher::stop() {
+    m_searchers[0]->stop();
+}
+
+SearchResult ParallelSearcher::search(const BoardState& root, const SearchLimits& limits) {
+    // helpers search the same root without a budget and only talk to the main thread through
+    // the shared table; they are stopped as soon as the main thread finishes
+    m_tt.newSearch();
+    std::vector<SearchResult> results(m_searchers.size());
+    std::vector<std::thread> helpers;
+    SearchLimits helperLimits;
+    helperLimits.maxDepth = limits.maxDepth;
+
+    for (size_t i = 1; i < m_searchers.size(); i++) {
+        helpers.emplace_back([this, &root, &helperLimits, &results, i] {
+            results[i] = m_searchers[i]->search(root, helperLimits);
+        });
+    }
+    results[0] = m_searchers[0]->search(root, limits);
+
+    for (size_t i = 1; i < m_searchers.size(); i++) {
+        m_searchers[i]->stop();
+    }
+    for (std::thread& helper : helpers) {
+        helper.join();
+    }
+
+    // prefer whichever thread completed the deepest iteration
+    SearchResult best = results[0];
+    uint64_t nodes = 0;
+    for (const SearchResult& result : results) {
+        nodes += result.nodes;
+        if (result.depth > best.depth && !result.bestMove.isNull()) {
+            best = result;
+        }
+    }
+    best.nodes = nodes;
+    best.timeMs = results[0].timeMs;
+    return best;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "BoardState.h"
+#include "Tablebase.h"
+#include "TranspositionTable.h"
+
+const int MAX_PLY = 64;
+const int INF_SCORE = 32001;
+const int MATE_SCORE = 32000;
+const int MATE_BOUND = MATE_SCORE - MAX_PLY;  // scores beyond this are mates
+
+struct SearchLimits {
+	int maxDepth = MAX_PLY - 1;
+	uint64_t maxNodes = 0;   // 0 means no node budget
+	int64_t moveTimeMs = 0;  // 0 means no time budget
+};
+
+struct SearchResult {
+	EngineMove bestMove;
+	int score = 0;           // centipawns from the side to move
+	int depth = 0;           // last fully completed iteration
+	uint64_t nodes = 0;
+	int64_t timeMs = 0;
+	std::vector<EngineMove> pv;
+	bool tablebase = false;  // the root was answered by an endgame table without searching
+};
+
+class Searcher {
+public:
+	// searchers sharing a table reuse each other's results; without one the searcher owns a small table.
+	// A shared table is not aged by search(), the caller calls newSearch() on it.
+	// threadIndex is the searcher's slot in a ParallelSearcher, 0 for the main thread
+	explicit Searcher(TranspositionTable* tt = nullptr, int threadIndex = 0);
+
+	SearchResult search(const BoardState& root, const SearchLimits& limits);
+
+	// may be called from another thread to end the search early
+	void stop();
+
+	uint64_t nodes() const;
+
+	// endgame tables probed at the root and in the tree, nullptr to search every position
+	void setTablebase(const Tablebase* tablebase);
+
+private:
+	int searchRoot(int depth, int alpha, int beta);
+	int negamax(int depth, int ply, int alpha, int beta);
+	int quiescence(int ply, int alpha, int beta);
+	void updateQuietStats(EngineMove move, int ply, int depth, const EngineMove* quietsTried, int quietCount);
+	bool outOfBudget();
+	int64_t elapsedMs() const;
+
+	TranspositionTable* m_tt;
+	std::unique_ptr<TranspositionTable> m_ownedTT;
+	const Tablebase* m_tablebase;
+	int m_threadIndex;
+	uint64_t m_ttProbes;
+	uint64_t m_ttHits;
+
+	BoardState m_board;
+	SearchLimits m_limits;
+	std::atomic<bool> m_stop;
+	uint64_t m_nodes;
+	std::chrono::steady_clock::time_point m_start;
+	MoveList m_rootMoves;
+
+	EngineMove m_pv[MAX_PLY + 1][MAX_PLY + 1];
+	int m_pvLength[MAX_PLY + 1];
+
+	// move ordering state is private to each thread
+	EngineMove m_moveStack[MAX_PLY + 1];     // move played at each ply, for counter moves
+	EngineMove m_killers[MAX_PLY + 1][2];
+	EngineMove m_counterMoves[64][64];       // indexed by the previous move's from and to squares
+	int m_history[2][64][64];
+};
+
+// Lazy SMP: every thread runs its own Searcher over the same root and they share one table
+class ParallelSearcher {
+public:
+	// threads <= 0 uses every core
+	ParallelSearcher(TranspositionTable& tt, int threads = 0);
+
+	void setThreads(int threads);
+	int threads() const;
+
+	// the node budget is counted on the main thread only
+	SearchResult search(const BoardState& root, const SearchLimits& limits);
+	void stop();
+
+	void setTablebase(const Tablebase* tablebase);
+
+private:
+	TranspositionTable& m_tt;
+	const Tablebase* m_tablebase;
+	std::vector<std::unique_ptr<Searcher>> m_searchers;
+};
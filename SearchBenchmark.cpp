@@ -0,0 +1,66 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Search.h"
+
+// Time-to-depth benchmark for the parallel search
+// usage: SearchBenchmark [depth] [max threads] [hash MB]
+
+static const char* benchmarkPositions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+};
+
+int main(int argc, char* argv[]) {
+    int depth = argc > 1 ? std::stoi(argv[1]) : 7;
+    int maxThreads = argc > 2 ? std::stoi(argv[2]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    size_t hashMb = argc > 3 ? std::stoul(argv[3]) : 64;
+
+    TranspositionTable tt(hashMb);
+    SearchLimits limits;
+    limits.maxDepth = depth;
+
+    std::cout << "depth " << depth << ", " << hashMb << " MB hash" << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "time ms" << std::setw(14) << "nodes"
+        << std::setw(12) << "knps" << std::setw(10) << "speedup" << std::setw(10) << "hit %" << std::endl;
+
+    // powers of two below the maximum, always finishing on the full thread count
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(std::max(maxThreads, 1));
+
+    int64_t baseTime = 0;
+    for (int threads : threadCounts) {
+        ParallelSearcher searcher(tt, threads);
+        int64_t totalTime = 0;
+        uint64_t totalNodes = 0;
+        double hitRate = 0.0;
+
+        for (const char* fen : benchmarkPositions) {
+            BoardState board;
+            BoardState::fromFen(fen, board);
+            tt.clear();  // every run starts cold so the thread counts are comparable
+            SearchResult result = searcher.search(board, limits);
+            totalTime += result.timeMs;
+            totalNodes += result.nodes;
+            hitRate += tt.stats().hitRate;
+        }
+        if (threads == 1) {
+            baseTime = totalTime;
+        }
+
+        std::cout << std::setw(8) << threads << std::setw(12) << totalTime << std::setw(14) << totalNodes
+            << std::setw(12) << totalNodes / std::max<int64_t>(totalTime, 1)
+            << std::setw(10) << std::fixed << std::setprecision(2) << static_cast<double>(baseTime) / std::max<int64_t>(totalTime, 1)
+            << std::setw(10) << std::setprecision(1) << 100.0 * hitRate / std::size(benchmarkPositions) << std::endl;
+    }
+    return 0;
+}
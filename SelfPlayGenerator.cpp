@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BoardState.h"
+#include "Search.h"
+#ifdef CHESS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Plays games on every core and writes one training sample per position: the board, the legal
+// moves as destination masks, the move played and the game's result.
+// usage: SelfPlayGenerator <output directory> [--games n] [--threads n] [--mode random|engine]
+//        [--nodes n] [--random-plies n] [--max-plies n] [--openings file] [--chunk samples] [--seed n]
+//        [--variant name]
+//
+// Every thread plays whole games with its own RNG and searcher and writes its own chunk files,
+// samples-<thread>-<chunk>.bin, so threads share nothing but a counter handing out game numbers.
+// Game g's RNG is seeded from seed + g. Games start from the start position or a random line of
+// the openings file (one FEN a line), play random-plies random moves and then either random
+// moves or the engine's best move at the node budget. Chess960 games start from a random one of its
+// positions, so a sample's castling rights are those of the rooks that game started with.
+//
+// A chunk file is a 32-byte header followed by its samples, zlib-compressed when flags bit 0 is set:
+//   char magic[4] "CSP1", uint32 version, uint32 flags, uint32 samples, uint64 raw bytes, uint64 stored bytes
+// with the Variant in flags bits 8-15.
+// A sample, little-endian with no padding:
+//   uint8  squares[32]   two squares a byte, the even one in the low nibble; BoardState piece codes
+//   uint8  state         bit 0 black to move, bits 1-4 castling rights
+//   uint8  checks        checks given in three-check, white's in bits 0-1 and black's in bits 2-3
+//   uint16 rookFiles     file of each castling right's rook, three bits each by castlingIndex, for Chess960
+//   int8   epSquare      -1 when there is none
+//   uint16 ply
+//   uint16 move          EngineMove played
+//   int8   result        1 won, 0 drawn, -1 lost, for the side to move
+//   uint64 origins       squares with a legal move
+//   uint64 destinations[popcount(origins)], in square order
+
+static const uint32_t CHUNK_VERSION = 2;
+static const uint32_t FLAG_ZLIB = 1;
+
+struct Options {
+    std::filesystem::path output;
+    uint64_t games = 10000;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    bool engine = false;
+    uint64_t nodes = 2000;
+    int randomPlies = 8;
+    int maxPlies = 400;
+    size_t chunkSamples = 1 << 16;
+    uint64_t seed = 1;
+    Variant variant = Variant::STANDARD;
+    std::vector<BoardState> openings;
+};
+
+struct Progress {
+    std::atomic<uint64_t> nextGame{ 0 };
+    std::atomic<uint64_t> gamesDone{ 0 };
+    std::atomic<uint64_t> samples{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+};
+
+template <typename T>
+static void put(std::vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// a position and its legal moves, the move and result are filled in once known
+static void appendSample(std::vector<uint8_t>& out, const BoardState& board, int ply, EngineMove played) {
+    for (int sq = 0; sq < 64; sq += 2) {
+        out.push_back(static_cast<uint8_t>(board.squares[sq] | (board.squares[sq + 1] << 4)));
+    }
+    out.push_back(static_cast<uint8_t>((board.turn == Piece::Color::BLACK ? 1 : 0) | (board.castling << 1)));
+    out.push_back(static_cast<uint8_t>(board.checks[0] | (board.checks[1] << 2)));
+    uint16_t rookFiles = 0;
+    for (int i = 0; i < 4; i++) {
+        rookFiles |= static_cast<uint16_t>(colOf(board.castlingRooks[i]) << (i * 3));
+    }
+    put<uint16_t>(out, rookFiles);
+    put<int8_t>(out, board.epSquare);
+    put<uint16_t>(out, static_cast<uint16_t>(ply));
+    put<uint16_t>(out, played.data);
+    put<int8_t>(out, 0);
+
+    LegalMask mask;
+    generateLegalMask(board, mask);
+    Bitboard origins = mask.origins();
+    put<uint64_t>(out, origins);
+    for (Bitboard from = origins; from;) {
+        put<uint64_t>(out, mask.destinations[popLsb(from)]);
+    }
+}
+
+static const size_t RESULT_OFFSET = 32 + 1 + 1 + 2 + 1 + 2 + 2;
+
+class ChunkWriter {
+public:
+    ChunkWriter(const std::filesystem::path& directory, int thread, size_t chunkSamples, Variant variant, Progress& progress)
+        : m_directory(directory), m_thread(thread), m_chunkSamples(chunkSamples), m_variant(variant), m_chunk(0), m_samples(0), m_progress(progress) {}
+
+    ~ChunkWriter() {
+        flush();
+    }
+
+    void add(const std::vector<uint8_t>& samples, size_t count) {
+        m_buffer.insert(m_buffer.end(), samples.begin(), samples.end());
+        m_samples += count;
+        if (m_samples >= m_chunkSamples) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (m_samples == 0) {
+            return;
+        }
+        uint32_t flags = static_cast<uint32_t>(m_variant) << 8;
+        const std::vector<uint8_t>* payload = &m_buffer;
+#ifdef CHESS_HAVE_ZLIB
+        uLongf packedSize = compressBound(static_cast<uLong>(m_buffer.size()));
+        m_packed.resize(packedSize);
+        if (compress2(m_packed.data(), &packedSize, m_buffer.data(), static_cast<uLong>(m_buffer.size()), Z_DEFAULT_COMPRESSION) == Z_OK) {
+            m_packed.resize(packedSize);
+            payload = &m_packed;
+            flags |= FLAG_ZLIB;
+        }
+#endif
+        std::vector<uint8_t> header;
+        header.insert(header.end(), { 'C', 'S', 'P', '1' });
+        put<uint32_t>(header, CHUNK_VERSION);
+        put<uint32_t>(header, flags);
+        put<uint32_t>(header, static_cast<uint32_t>(m_samples));
+        put<uint64_t>(header, m_buffer.size());
+        put<uint64_t>(header, payload->size());
+
+        std::filesystem::path path = m_directory / ("samples-" + std::to_string(m_thread) + "-" + std::to_string(m_chunk++) + ".bin");
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        out.write(reinterpret_cast<const char*>(payload->data()), static_cast<std::streamsize>(payload->size()));
+        if (!out) {
+            std::cerr << "cannot write " << path.string() << std::endl;
+        }
+        m_progress.bytes.fetch_add(header.size() + payload->size(), std::memory_order_relaxed);
+        m_buffer.clear();
+        m_samples = 0;
+    }
+
+private:
+    std::filesystem::path m_directory;
+    int m_thread;
+    size_t m_chunkSamples;
+    Variant m_variant;
+    int m_chunk;
+    size_t m_samples;
+    std::vector<uint8_t> m_buffer;
+    std::vector<uint8_t> m_packed;
+    Progress& m_progress;
+};
+
+// one game from start to finish; returns the number of samples appended to out
+static size_t playGame(const Options& options, uint64_t game, Searcher* searcher, std::vector<uint8_t>& out) {
+    std::mt19937_64 rng(options.seed + game);
+    BoardState board;
+    if (!options.openings.empty()) {
+        board = options.openings[rng() % options.openings.size()];
+    }
+    else {
+        board = options.variant == Variant::CHESS960 ? BoardState::startPosition(Variant::CHESS960, static_cast<int>(rng() % 960)) : BoardState::startPosition(options.variant);
+    }
+
+    std::vector<size_t> sampleStarts;
+    std::vector<Piece::Color> movers;
+    std::vector<uint64_t> keys = { board.key };  // since the last capture or pawn move
+    MoveList legal;
+    SearchLimits limits;
+    limits.maxNodes = options.nodes;
+    int result = 0;   // 1 white won, -1 black won
+
+    for (int ply = 0; ply < options.maxPlies; ply++) {
+        if (board.variantLoss()) {
+            result = board.turn == Piece::Color::WHITE ? -1 : 1;
+            break;
+        }
+        legal.size = 0;
+        generateLegalMoves(board, legal);
+        if (legal.size == 0) {
+            if (board.inCheck()) {
+                result = board.turn == Piece::Color::WHITE ? -1 : 1;
+            }
+            break;
+        }
+        if (keys.size() > 100 || board.insufficientMaterial() || std::count(keys.begin(), keys.end(), board.key) >= 3) {
+            break;
+        }
+
+        EngineMove move;
+        if (searcher && ply >= options.randomPlies) {
+            move = searcher->search(board, limits).bestMove;
+        }
+        if (move.isNull()) {
+            move = legal.moves[rng() % static_cast<uint64_t>(legal.size)];
+        }
+        sampleStarts.push_back(out.size());
+        movers.push_back(board.turn);
+        appendSample(out, board, ply, move);
+
+        bool castles = move.mtype() == PositionType::MoveType::KCASTLE || move.mtype() == PositionType::MoveType::QCASTLE;
+        bool irreversible = (board.squares[move.to()] != NO_PIECE && !castles) || typeOf(board.squares[move.from()]) == Piece::PieceType::PAWN;
+        UndoInfo undo;
+        board.makeMove(move, undo);
+        if (irreversible) {
+            keys.clear();
+        }
+        keys.push_back(board.key);
+    }
+
+    for (size_t i = 0; i < sampleStarts.size(); i++) {
+        int8_t forMover = static_cast<int8_t>(movers[i] == Piece::Color::WHITE ? result : -result);
+        std::memcpy(&out[sampleStarts[i] + RESULT_OFFSET], &forMover, 1);
+    }
+    return sampleStarts.size();
+}
+
+static void worker(const Options& options, int thread, Progress& progress) {
+    ChunkWriter writer(options.output, thread, options.chunkSamples, options.variant, progress);
+    std::unique_ptr<Searcher> searcher = options.engine ? std::make_unique<Searcher>() : nullptr;
+    std::vector<uint8_t> samples;
+    for (uint64_t game = progress.nextGame.fetch_add(1, std::memory_order_relaxed); game < options.games;
+        game = progress.nextGame.fetch_add(1, std::memory_order_relaxed)) {
+        samples.clear();
+        size_t count = playGame(options, game, searcher.get(), samples);
+        writer.add(samples, count);
+        progress.samples.fetch_add(count, std::memory_order_relaxed);
+        progress.gamesDone.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: SelfPlayGenerator <output directory> [--games n] [--threads n] [--mode random|engine] [--nodes n]"
+            " [--random-plies n] [--max-plies n] [--openings file] [--chunk samples] [--seed n] [--variant name]" << std::endl;
+        return 1;
+    }
+    Options options;
+    options.output = argv[1];
+    std::string openings;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--games") options.games = std::stoull(value);
+        else if (flag == "--threads") options.threads = std::max(1, std::stoi(value));
+        else if (flag == "--mode") options.engine = value == "engine";
+        else if (flag == "--nodes") options.nodes = std::stoull(value);
+        else if (flag == "--random-plies") options.randomPlies = std::stoi(value);
+        else if (flag == "--max-plies") options.maxPlies = std::stoi(value);
+        else if (flag == "--chunk") options.chunkSamples = std::max<size_t>(1, std::stoull(value));
+        else if (flag == "--seed") options.seed = std::stoull(value);
+        else if (flag == "--variant") {
+            if (!variantFromName(value.c_str(), options.variant)) {
+                std::cerr << "unknown variant " << value << std::endl;
+                return 1;
+            }
+        }
+        else if (flag == "--openings") openings = value;
+        else {
+            std::cerr << "unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+    // read once the variant is known, whichever order the options came in
+    if (!openings.empty()) {
+        std::ifstream in(openings);
+        std::string fen;
+        BoardState position;
+        while (std::getline(in, fen)) {
+            if (BoardState::fromFen(fen, position, options.variant)) {
+                options.openings.push_back(position);
+            }
+        }
+        if (options.openings.empty()) {
+            std::cerr << "no positions in " << openings << std::endl;
+            return 1;
+        }
+    }
+    std::error_code error;
+    std::filesystem::create_directories(options.output, error);
+
+    Progress progress;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.threads; i++) {
+        threads.emplace_back(worker, std::cref(options), i, std::ref(progress));
+    }
+
+    auto report = [&] {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t samples = progress.samples.load(std::memory_order_relaxed);
+        std::cout << progress.gamesDone.load(std::memory_order_relaxed) << "/" << options.games << " games, " << samples << " samples, "
+            << static_cast<uint64_t>(samples / std::max(seconds, 1e-9)) << " samples/s, " << progress.bytes.load(std::memory_order_relaxed)
+            << " bytes written" << std::endl;
+    };
+    auto lastReport = start;
+    while (progress.gamesDone.load(std::memory_order_relaxed) < options.games) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (std::chrono::steady_clock::now() - lastReport >= std::chrono::seconds(5)) {
+            lastReport = std::chrono::steady_clock::now();
+            report();
+        }
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    report();
+    return 0;
+}
@@ -0,0 +1,326 @@
+#include "Tablebase.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+struct Tablebase::MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+
+    bool open(const std::string& path) {
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            return false;
+        }
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        size = static_cast<size_t>(fileSize.QuadPart);
+        return data != nullptr;
+    }
+
+    ~MappedFile() {
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    }
+#else
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        // the mapping keeps the file alive once the descriptor is closed
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const uint8_t*>(mapped);
+        size = static_cast<size_t>(info.st_size);
+        return true;
+    }
+
+    ~MappedFile() {
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+    }
+#endif
+};
+
+// non-king piece types in signature order, with their letters
+static const Piece::PieceType::Type signatureTypes[5] = {
+    Piece::PieceType::QUEEN, Piece::PieceType::ROOK, Piece::PieceType::BISHOP, Piece::PieceType::KNIGHT, Piece::PieceType::PAWN
+};
+static const char pieceLetters[] = "?PKQRNB";  // indexed by Piece::PieceType::Type
+
+// rows are bytes, so swapping the bytes mirrors the board top to bottom
+static Bitboard flipRanks(Bitboard b) {
+    b = ((b >> 8) & 0x00FF00FF00FF00FFULL) | ((b & 0x00FF00FF00FF00FFULL) << 8);
+    b = ((b >> 16) & 0x0000FFFF0000FFFFULL) | ((b & 0x0000FFFF0000FFFFULL) << 16);
+    return (b >> 32) | (b << 32);
+}
+
+// and reversing the bits of every byte mirrors it left to right
+static Bitboard mirrorFiles(Bitboard b) {
+    b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+    b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+    return ((b >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((b & 0x0F0F0F0F0F0F0F0FULL) << 4);
+}
+
+static uint64_t sideMaterial(const int* counts) {
+    uint64_t key = 0;
+    for (int i = 0; i < 5; i++) {
+        key |= static_cast<uint64_t>(counts[signatureTypes[i]] & 15) << (i * 4);
+    }
+    return key;
+}
+
+uint64_t materialKey(const BoardState& board, bool flip) {
+    int counts[2][7] = {};
+    for (int c = 0; c < 2; c++) {
+        for (Piece::PieceType::Type type : signatureTypes) {
+            counts[c][type] = popCount(board.byColor[c] & board.byType[type]);
+        }
+    }
+    int white = flip ? 1 : 0;
+    return sideMaterial(counts[white]) | (sideMaterial(counts[1 - white]) << 20);
+}
+
+bool TablebaseLayout::fromName(const std::string& name, TablebaseLayout& out) {
+    size_t split = name.find('v');
+    if (split == std::string::npos || name.find('v', split + 1) != std::string::npos) {
+        return false;
+    }
+    out = TablebaseLayout();
+    std::string sides[2] = { name.substr(0, split), name.substr(split + 1) };
+    if (sides[0].size() + sides[1].size() > TB_MAX_PIECES) {
+        return false;
+    }
+    for (int c = 0; c < 2; c++) {
+        Piece::Color color = c == 0 ? Piece::Color::WHITE : Piece::Color::BLACK;
+        if (sides[c].empty() || sides[c][0] != 'K') {
+            return false;
+        }
+        for (size_t i = 0; i < sides[c].size(); i++) {
+            const char* letter = std::strchr(pieceLetters + 1, sides[c][i]);
+            if (letter == nullptr || (i > 0 && *letter == 'K')) {
+                return false;
+            }
+            out.pieces[out.count++] = pieceCode(color, static_cast<Piece::PieceType::Type>(letter - pieceLetters));
+        }
+    }
+    return true;
+}
+
+std::string TablebaseLayout::name() const {
+    std::string name;
+    for (int i = 0; i < count; i++) {
+        if (i > 0 && typeOf(pieces[i]) == Piece::PieceType::KING) {
+            name += 'v';
+        }
+        name += pieceLetters[typeOf(pieces[i])];
+    }
+    return name;
+}
+
+uint64_t TablebaseLayout::entries() const {
+    // side to move, the white king on 32 squares, every other piece on 64
+    uint64_t entries = 2 * 32;
+    for (int i = 1; i < count; i++) {
+        entries *= 64;
+    }
+    return entries;
+}
+
+uint64_t TablebaseLayout::materialKey() const {
+    int counts[2][7] = {};
+    for (int i = 0; i < count; i++) {
+        counts[colorIndex(colorOf(pieces[i]))][typeOf(pieces[i])]++;
+    }
+    return sideMaterial(counts[0]) | (sideMaterial(counts[1]) << 20);
+}
+
+uint64_t TablebaseLayout::index(const BoardState& board, bool flip) const {
+    Piece::Color turn = flip ? opposite(board.turn) : board.turn;
+    int whiteKing = board.kingSquare(flip ? Piece::Color::BLACK : Piece::Color::WHITE);
+    if (flip) {
+        whiteKing ^= 56;
+    }
+    bool mirror = colOf(whiteKing) >= 4;
+    if (mirror) {
+        whiteKing ^= 7;
+    }
+
+    uint64_t index = colorIndex(turn) * 32 + rowOf(whiteKing) * 4 + colOf(whiteKing);
+    Bitboard used = 0;
+    for (int i = 1; i < count; i++) {
+        Piece::Color color = colorOf(pieces[i]);
+        Bitboard candidates = board.pieces(flip ? opposite(color) : color, typeOf(pieces[i]));
+        if (flip) candidates = flipRanks(candidates);
+        if (mirror) candidates = mirrorFiles(candidates);
+
+        // identical pieces are taken lowest square first so each position has a single index
+        int sq = lsb(candidates & ~used);
+        used |= squareBB(sq);
+        index = index * 64 + sq;
+    }
+    return index;
+}
+
+bool TablebaseLayout::decode(uint64_t index, int* squares, Piece::Color& turn) const {
+    Bitboard used = 0;
+    for (int i = count - 1; i >= 1; i--) {
+        squares[i] = static_cast<int>(index & 63);
+        index >>= 6;
+    }
+    int king = static_cast<int>(index & 31);
+    squares[0] = squareOf(king / 4, king % 4);
+    turn = (index >> 5) ? Piece::Color::BLACK : Piece::Color::WHITE;
+
+    for (int i = 0; i < count; i++) {
+        if (used & squareBB(squares[i])) {
+            return false;
+        }
+        used |= squareBB(squares[i]);
+    }
+    return true;
+}
+
+Tablebase::Tablebase() : m_maxPieces(0) {}
+
+Tablebase::~Tablebase() = default;
+
+int Tablebase::load(const std::string& directory) {
+    std::error_code error;
+    int loaded = 0;
+    for (const auto& item : std::filesystem::directory_iterator(directory, error)) {
+        if (item.path().extension() != ".tb") {
+            continue;
+        }
+        auto file = std::make_unique<MappedFile>();
+        if (!file->open(item.path().string()) || file->size < sizeof(TablebaseFileHeader)) {
+            continue;
+        }
+
+        TablebaseFileHeader header;
+        std::memcpy(&header, file->data, sizeof(header));
+        TablebaseLayout layout;
+        layout.count = static_cast<int>(header.pieceCount);
+        if (std::memcmp(header.magic, "MCTB", 4) != 0 || header.version != TB_VERSION ||
+            layout.count < 2 || layout.count > TB_MAX_PIECES) {
+            continue;
+        }
+        std::memcpy(layout.pieces, header.pieces, sizeof(layout.pieces));
+        if (header.entries != layout.entries() || file->size < sizeof(header) + header.entries ||
+            layout.pieces[0] != pieceCode(Piece::Color::WHITE, Piece::PieceType::KING) || m_tables.count(layout.materialKey())) {
+            continue;
+        }
+
+        Table& table = m_tables[layout.materialKey()];
+        table.layout = layout;
+        table.data = file->data + sizeof(header);
+        table.file = std::move(file);
+        m_maxPieces = std::max(m_maxPieces, layout.count);
+        loaded++;
+    }
+    return loaded;
+}
+
+int Tablebase::maxPieces() const {
+    return m_maxPieces;
+}
+
+bool Tablebase::probe(const BoardState& board, TablebaseProbe& out) const {
+    // the tables know nothing of hills or check counts
+    if (board.castling || board.epSquare >= 0 || board.variant == Variant::KING_OF_THE_HILL || board.variant == Variant::THREE_CHECK) {
+        return false;
+    }
+    int pieces = popCount(board.occupied());
+    if (pieces == 2) {
+        out = TablebaseProbe();
+        return true;
+    }
+    if (pieces > m_maxPieces) {
+        return false;
+    }
+
+    bool flip = false;
+    auto found = m_tables.find(materialKey(board));
+    if (found == m_tables.end()) {
+        flip = true;
+        found = m_tables.find(materialKey(board, true));
+        if (found == m_tables.end()) {
+            return false;
+        }
+    }
+
+    const Table& table = found->second;
+    if (table.layout.count != pieces) {
+        return false;
+    }
+    uint8_t value = table.data[table.layout.index(board, flip)];
+    if (value < TB_DECIDED) {
+        out = TablebaseProbe();
+        return value == TB_DRAW;
+    }
+    out.plies = value - TB_DECIDED;
+    out.wdl = (out.plies & 1) ? 1 : -1;
+    return true;
+}
+
+bool Tablebase::probeRoot(const BoardState& board, EngineMove& best, TablebaseProbe& result) const {
+    BoardState copy = board;
+    MoveList list;
+    generateLegalMoves(copy, list);
+    if (list.size == 0) {
+        return false;
+    }
+
+    int bestRank = 0;
+    best = EngineMove();
+    for (EngineMove move : list) {
+        UndoInfo undo;
+        copy.makeMove(move, undo);
+        TablebaseProbe child;
+        bool covered = probe(copy, child);
+        copy.unmakeMove(undo);
+        if (!covered) {
+            return false;
+        }
+
+        // quicker wins rank highest and slower losses rank above quicker ones
+        int rank = child.wdl < 0 ? 1000 - child.plies : child.wdl > 0 ? -1000 + child.plies : 0;
+        if (best.isNull() || rank > bestRank) {
+            bestRank = rank;
+            best = move;
+            result.wdl = -child.wdl;
+            result.plies = child.wdl ? child.plies + 1 : 0;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "BoardState.h"
+
+// Endgame tables for positions with few pieces, one memory-mapped file per material signature
+// such as KQvKR. A file holds one byte per position: win, draw or loss for the side to move, and
+// for decided positions the exact number of plies to mate with best play. Positions are indexed
+// densely by side to move and the square of every piece in the signature's order. The first
+// piece is always the white king, mirrored onto files a-d, which halves the file. A table also
+// answers for the colour-reversed material (KRvKQ from KQvKR) by mirroring the board top to
+// bottom. Tables assume no castling rights and no en passant square.
+
+const int TB_MAX_PIECES = 8;
+
+// stored byte values: 0 and 1 are below, 2 + n is a decided result n plies from mate, a win for
+// the side to move when n is odd and a loss when it is even
+const uint8_t TB_ILLEGAL = 0;  // pieces overlap or the side not to move is in check
+const uint8_t TB_DRAW = 1;
+const uint8_t TB_DECIDED = 2;
+
+// the layout of one table: which pieces it holds and how positions map to entries
+struct TablebaseLayout {
+	int count = 0;
+	uint8_t pieces[TB_MAX_PIECES] = {};  // piece codes in index order, the white king first
+
+	// parses a signature such as "KQvKR", white's pieces before the v
+	static bool fromName(const std::string& name, TablebaseLayout& out);
+	std::string name() const;
+
+	uint64_t entries() const;
+	uint64_t materialKey() const;
+
+	// index of a position with this material. flip swaps the colours and mirrors the ranks, for
+	// boards holding the colour-reversed material
+	uint64_t index(const BoardState& board, bool flip = false) const;
+
+	// the squares of every piece and the side to move, false when two pieces share a square
+	bool decode(uint64_t index, int* squares, Piece::Color& turn) const;
+};
+
+// counts of every non-king piece type for both colours, equal for positions sharing a table
+uint64_t materialKey(const BoardState& board, bool flip = false);
+
+struct TablebaseProbe {
+	int wdl = 0;    // 1 win, 0 draw, -1 loss for the side to move
+	int plies = 0;  // plies to mate with best play, 0 for a draw
+};
+
+struct TablebaseFileHeader {
+	char magic[4];        // "MCTB"
+	uint32_t version;
+	uint32_t pieceCount;
+	uint32_t reserved;
+	uint8_t pieces[TB_MAX_PIECES];
+	uint64_t entries;     // entry bytes follow the header
+};
+
+const uint32_t TB_VERSION = 1;
+
+class Tablebase {
+public:
+	Tablebase();
+	~Tablebase();
+
+	// maps every .tb file in a directory and returns how many loaded; safe to call more than once
+	int load(const std::string& directory);
+
+	// the most pieces any loaded table holds, 0 when none are loaded
+	int maxPieces() const;
+
+	// false when no loaded table covers the position. Bare kings are always a draw.
+	bool probe(const BoardState& board, TablebaseProbe& out) const;
+
+	// the move with the best table result: the fastest win, any draw, else the slowest loss.
+	// Fails when the position or any position after a legal move is not covered.
+	bool probeRoot(const BoardState& board, EngineMove& best, TablebaseProbe& result) const;
+
+private:
+	struct MappedFile;
+	struct Table {
+		TablebaseLayout layout;
+		const uint8_t* data;
+		std::unique_ptr<MappedFile> file;
+	};
+
+	std::unordered_map<uint64_t, Table> m_tables;  // by material key
+	int m_maxPieces;
+};
@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Tablebase.h"
+
+// Builds endgame tables by retrograde analysis.
+// usage: TablebaseGenerator <output directory> [signature ...]
+// With no signatures every 3 piece table is built. Tables a signature captures or promotes into
+// are built first when they are not in the output directory yet.
+//
+// Every position of the table is classified once by generating its moves: moves that capture or
+// promote leave the table and are scored from the smaller tables, the rest are counted. Then
+// passes run outwards from mate, one ply per pass. A pass collects the positions decided at that
+// distance into a bit-packed frontier and un-moves every one of them. A predecessor of a lost
+// position is won one ply further from mate. A predecessor of a won position has one fewer
+// unrefuted move, and it is lost once none are left. Positions never decided are draws.
+
+static const uint8_t UNKNOWN = 255;
+static const uint8_t HAS_DRAW_EXIT = 255;  // in exitInfo: some capture or promotion draws
+
+static int threadCount() {
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// runs body(begin, end) over [0, count) in blocks taken by every thread in turn
+static void parallelFor(uint64_t count, const std::function<void(uint64_t, uint64_t)>& body) {
+    const uint64_t block = 1 << 14;
+    std::atomic<uint64_t> next(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threadCount(); i++) {
+        workers.emplace_back([&] {
+            for (uint64_t begin = next.fetch_add(block); begin < count; begin = next.fetch_add(block)) {
+                body(begin, std::min(begin + block, count));
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// the side with more pieces, or the more valuable ones, goes first so every table has one name
+static std::string canonicalName(const std::string& name) {
+    size_t split = name.find('v');
+    std::string white = name.substr(0, split);
+    std::string black = name.substr(split + 1);
+    auto rank = [](const std::string& side) {
+        std::string ranked;
+        for (char letter : side) {
+            ranked += static_cast<char>('0' + std::string("KQRBNP").find(letter));
+        }
+        return ranked;
+    };
+    if (black.size() > white.size() || (black.size() == white.size() && rank(black) < rank(white))) {
+        std::swap(white, black);
+    }
+    return white + "v" + black;
+}
+
+static bool tableExists(const std::filesystem::path& directory, const std::string& name) {
+    size_t split = name.find('v');
+    std::string reversed = name.substr(split + 1) + "v" + name.substr(0, split);
+    return std::filesystem::exists(directory / (name + ".tb")) || std::filesystem::exists(directory / (reversed + ".tb"));
+}
+
+// tables reached by capturing any one piece or by promoting a pawn
+static std::vector<std::string> successorNames(const std::string& name) {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < name.size(); i++) {
+        char letter = name[i];
+        if (letter == 'K' || letter == 'v') {
+            continue;
+        }
+        std::string captured = name.substr(0, i) + name.substr(i + 1);
+        if (captured != "KvK") {
+            names.push_back(canonicalName(captured));
+        }
+        if (letter == 'P') {
+            for (char promoted : std::string("QRBN")) {
+                std::string promotion = name;
+                promotion[i] = promoted;
+                names.push_back(canonicalName(promotion));
+            }
+        }
+    }
+    return names;
+}
+
+class Generator {
+public:
+    Generator(const TablebaseLayout& layout, const Tablebase& smaller)
+        : m_layout(layout), m_smaller(smaller), m_entries(layout.entries()), m_values(m_entries), m_counters(m_entries),
+        m_exitInfo(m_entries), m_frontier((m_entries + 63) / 64) {}
+
+    void run() {
+        parallelFor(m_entries, [this](uint64_t begin, uint64_t end) { classify(begin, end); });
+
+        for (int plies = 0; plies <= 255 - TB_DECIDED; plies++) {
+            std::atomic<bool> found(false), pending(false);
+            parallelFor(m_frontier.size(), [&](uint64_t begin, uint64_t end) { collect(begin, end, plies, found, pending); });
+            if (!found && !pending) {
+                break;
+            }
+            parallelFor(m_frontier.size(), [&](uint64_t begin, uint64_t end) { retract(begin, end, plies); });
+        }
+
+        for (auto& value : m_values) {
+            if (value == UNKNOWN) {
+                value = TB_DRAW;
+            }
+        }
+    }
+
+    bool write(const std::filesystem::path& path) const {
+        TablebaseFileHeader header{};
+        std::memcpy(header.magic, "MCTB", 4);
+        header.version = TB_VERSION;
+        header.pieceCount = static_cast<uint32_t>(m_layout.count);
+        std::memcpy(header.pieces, m_layout.pieces, sizeof(header.pieces));
+        header.entries = m_entries;
+
+        std::vector<char> bytes(m_entries);
+        for (uint64_t i = 0; i < m_entries; i++) {
+            bytes[i] = static_cast<char>(m_values[i].load(std::memory_order_relaxed));
+        }
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        return static_cast<bool>(file);
+    }
+
+    void printSummary(int64_t ms) const {
+        uint64_t wins = 0, draws = 0, losses = 0;
+        int longest = 0;
+        for (const auto& value : m_values) {
+            uint8_t v = value;
+            if (v == TB_DRAW) draws++;
+            else if (v >= TB_DECIDED) {
+                ((v - TB_DECIDED) & 1 ? wins : losses)++;
+                longest = std::max(longest, v - TB_DECIDED);
+            }
+        }
+        std::cout << m_layout.name() << ": " << wins << " wins, " << draws << " draws, " << losses << " losses, longest mate "
+            << longest << " plies, " << ms << " ms" << std::endl;
+    }
+
+private:
+    bool decode(uint64_t index, BoardState& board) const {
+        int squares[TB_MAX_PIECES];
+        Piece::Color turn;
+        if (!m_layout.decode(index, squares, turn)) {
+            return false;
+        }
+        board = BoardState();
+        for (int i = 0; i < m_layout.count; i++) {
+            if (typeOf(m_layout.pieces[i]) == Piece::PieceType::PAWN && (rowOf(squares[i]) == 0 || rowOf(squares[i]) == 7)) {
+                return false;
+            }
+            board.putPiece(m_layout.pieces[i], squares[i]);
+        }
+        board.turn = turn;
+        // the other order of two identical pieces is the same position under another index
+        return m_layout.index(board) == index && !board.isSquareAttacked(board.kingSquare(opposite(turn)), turn);
+    }
+
+    void setCandidate(uint64_t index, uint8_t value) {
+        uint8_t current = m_values[index].load(std::memory_order_relaxed);
+        while (value < current && !m_values[index].compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    void classify(uint64_t begin, uint64_t end) {
+        uint64_t material = m_layout.materialKey();
+        for (uint64_t index = begin; index < end; index++) {
+            BoardState board;
+            if (!decode(index, board)) {
+                m_values[index] = TB_ILLEGAL;
+                continue;
+            }
+
+            MoveList list;
+            generateLegalMoves(board, list);
+            int inside = 0;
+            int exitWin = 0;         // fastest win through a capture or promotion, 0 if none
+            int exitLongest = 0;     // slowest loss through one
+            bool exitDraw = false;
+            for (EngineMove move : list) {
+                UndoInfo undo;
+                board.makeMove(move, undo);
+                if (materialKey(board) == material) {
+                    inside++;
+                }
+                else {
+                    TablebaseProbe child;
+                    if (!m_smaller.probe(board, child)) {
+                        // smaller tables are built first, so this only happens when one failed to load
+                        child = TablebaseProbe();
+                    }
+                    if (child.wdl < 0 && (exitWin == 0 || child.plies + 1 < exitWin)) exitWin = child.plies + 1;
+                    else if (child.wdl > 0) exitLongest = std::max(exitLongest, child.plies + 1);
+                    else if (child.wdl == 0) exitDraw = true;
+                }
+                board.unmakeMove(undo);
+            }
+
+            m_counters[index] = static_cast<uint8_t>(inside);
+            m_exitInfo[index] = exitDraw ? HAS_DRAW_EXIT : static_cast<uint8_t>(exitLongest);
+            if (list.size == 0) {
+                m_values[index] = board.inCheck() ? TB_DECIDED : TB_DRAW;
+            }
+            else if (exitWin) {
+                m_values[index] = static_cast<uint8_t>(TB_DECIDED + exitWin);
+            }
+            else if (inside == 0 && !exitDraw) {
+                m_values[index] = static_cast<uint8_t>(TB_DECIDED + exitLongest);
+            }
+            else {
+                m_values[index] = UNKNOWN;
+            }
+        }
+    }
+
+    // frontier bits for the positions this many plies from mate, each thread filling whole words
+    void collect(uint64_t begin, uint64_t end, int plies, std::atomic<bool>& found, std::atomic<bool>& pending) {
+        uint8_t target = static_cast<uint8_t>(TB_DECIDED + plies);
+        bool any = false, later = false;
+        for (uint64_t word = begin; word < end; word++) {
+            uint64_t bits = 0;
+            uint64_t first = word * 64;
+            for (uint64_t i = 0; i < 64 && first + i < m_entries; i++) {
+                uint8_t value = m_values[first + i].load(std::memory_order_relaxed);
+                bits |= static_cast<uint64_t>(value == target) << i;
+                later |= value > target && value != UNKNOWN;
+            }
+            m_frontier[word] = bits;
+            any |= bits != 0;
+        }
+        if (any) found = true;
+        if (later) pending = true;
+    }
+
+    void retract(uint64_t begin, uint64_t end, int plies) {
+        for (uint64_t word = begin; word < end; word++) {
+            for (uint64_t bits = m_frontier[word]; bits; ) {
+                uint64_t index = word * 64 + popLsb(bits);
+                BoardState board;
+                decode(index, board);
+                forEachPredecessor(board, [&](uint64_t predecessor) {
+                    if (plies % 2 == 0) {
+                        // a move into a lost position wins
+                        setCandidate(predecessor, static_cast<uint8_t>(TB_DECIDED + plies + 1));
+                    }
+                    else if (m_counters[predecessor].fetch_sub(1, std::memory_order_relaxed) == 1) {
+                        // every move stays inside and wins for the opponent, this one last and slowest
+                        uint8_t exits = m_exitInfo[predecessor];
+                        if (exits != HAS_DRAW_EXIT && m_values[predecessor].load(std::memory_order_relaxed) == UNKNOWN) {
+                            setCandidate(predecessor, static_cast<uint8_t>(TB_DECIDED + std::max<int>(plies + 1, exits)));
+                        }
+                    }
+                });
+            }
+        }
+    }
+
+    // positions the side not to move could have moved from, without capturing or promoting
+    void forEachPredecessor(BoardState& board, const std::function<void(uint64_t)>& visit) const {
+        Piece::Color mover = opposite(board.turn);
+        Piece::Color turn = board.turn;
+        Bitboard occupied = board.occupied();
+        Bitboard pieces = board.byColor[colorIndex(mover)];
+        while (pieces) {
+            int to = popLsb(pieces);
+            Piece::PieceType::Type type = typeOf(board.squares[to]);
+            Bitboard origins = 0;
+            switch (type) {
+            case Piece::PieceType::KING: origins = kingAttacks(to); break;
+            case Piece::PieceType::KNIGHT: origins = knightAttacks(to); break;
+            case Piece::PieceType::BISHOP: origins = bishopAttacks(to, occupied); break;
+            case Piece::PieceType::ROOK: origins = rookAttacks(to, occupied); break;
+            case Piece::PieceType::QUEEN: origins = queenAttacks(to, occupied); break;
+            case Piece::PieceType::PAWN: {
+                // white pawns move towards row 0, so they came from the row below
+                int back = mover == Piece::Color::WHITE ? 8 : -8;
+                int startRow = mover == Piece::Color::WHITE ? 6 : 1;
+                int single = to + back;
+                if (rowOf(single) != 0 && rowOf(single) != 7 && !(occupied & squareBB(single))) {
+                    origins |= squareBB(single);
+                    int twice = single + back;
+                    if (rowOf(twice) == startRow && !(occupied & squareBB(twice))) {
+                        origins |= squareBB(twice);
+                    }
+                }
+                break;
+            }
+            default: break;
+            }
+            origins &= ~occupied;
+
+            while (origins) {
+                int from = popLsb(origins);
+                board.movePiece(to, from);
+                board.turn = mover;
+                uint64_t predecessor = m_layout.index(board);
+                if (m_values[predecessor].load(std::memory_order_relaxed) != TB_ILLEGAL) {
+                    visit(predecessor);
+                }
+                board.movePiece(from, to);
+                board.turn = turn;
+            }
+        }
+    }
+
+    TablebaseLayout m_layout;
+    const Tablebase& m_smaller;
+    uint64_t m_entries;
+    std::vector<std::atomic<uint8_t>> m_values;    // stored byte, or UNKNOWN while undecided
+    std::vector<std::atomic<uint8_t>> m_counters;  // moves staying in the table not yet known to win for the opponent
+    std::vector<uint8_t> m_exitInfo;               // slowest loss through a capture or promotion, or HAS_DRAW_EXIT
+    std::vector<uint64_t> m_frontier;
+};
+
+static bool generate(const std::string& name, const std::filesystem::path& directory, Tablebase& tables) {
+    if (tableExists(directory, name)) {
+        return true;
+    }
+    for (const std::string& successor : successorNames(name)) {
+        if (!generate(successor, directory, tables)) {
+            return false;
+        }
+    }
+    tables.load(directory.string());
+
+    TablebaseLayout layout;
+    TablebaseLayout::fromName(name, layout);
+    auto start = std::chrono::steady_clock::now();
+    Generator generator(layout, tables);
+    generator.run();
+    if (!generator.write(directory / (name + ".tb"))) {
+        std::cerr << "could not write " << name << ".tb" << std::endl;
+        return false;
+    }
+    generator.printSummary(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: TablebaseGenerator <output directory> [signature ...]" << std::endl;
+        return 1;
+    }
+    std::filesystem::path directory = argv[1];
+    std::filesystem::create_directories(directory);
+
+    std::vector<std::string> names;
+    for (int i = 2; i < argc; i++) {
+        TablebaseLayout layout;
+        if (!TablebaseLayout::fromName(argv[i], layout)) {
+            std::cerr << "bad signature " << argv[i] << std::endl;
+            return 1;
+        }
+        names.push_back(canonicalName(argv[i]));
+    }
+    if (names.empty()) {
+        names = { "KQvK", "KRvK", "KBvK", "KNvK", "KPvK" };
+    }
+
+    Tablebase tables;
+    for (const std::string& name : names) {
+        if (!generate(name, directory, tables)) {
+            return 1;
+        }
+    }
+    return 0;
+}
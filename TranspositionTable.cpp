@@ -0,0 +1,139 @@
+#include "TranspositionTable.h"
+#include <algorithm>
+#include <climits>
+
+
+// data word layout: move (16 bits) | score (16 bits) | depth (8 bits) | bound (2 bits) | generation (6 bits)
+static uint64_t packData(EngineMove move, int score, int depth, Bound bound, uint8_t generation) {
+    return static_cast<uint64_t>(move.data) |
+        (static_cast<uint64_t>(static_cast<uint16_t>(score)) << 16) |
+        (static_cast<uint64_t>(std::clamp(depth, 0, 255)) << 32) |
+        (static_cast<uint64_t>(bound) << 40) |
+        (static_cast<uint64_t>(generation & 63) << 42);
+}
+
+static int depthOf(uint64_t data) { return static_cast<int>((data >> 32) & 255); }
+static Bound boundOf(uint64_t data) { return static_cast<Bound>((data >> 40) & 3); }
+static uint8_t generationOf(uint64_t data) { return static_cast<uint8_t>((data >> 42) & 63); }
+
+TranspositionTable::TranspositionTable(size_t sizeMb) : m_bucketCount(0), m_generation(0), m_probes(0), m_hits(0) {
+    resize(sizeMb);
+}
+
+void TranspositionTable::resize(size_t sizeMb) {
+    // round down to a power of two number of buckets so the index is a mask
+    size_t buckets = std::max<size_t>(sizeMb, 1) * 1024 * 1024 / sizeof(Bucket);
+    m_bucketCount = 1;
+    while (m_bucketCount * 2 <= buckets) {
+        m_bucketCount *= 2;
+    }
+    m_buckets.reset(new Bucket[m_bucketCount]);
+    clear();
+}
+
+void TranspositionTable::clear() {
+    for (size_t i = 0; i < m_bucketCount; i++) {
+        for (Entry& entry : m_buckets[i].entries) {
+            entry.keyXorData.store(0, std::memory_order_relaxed);
+            entry.data.store(0, std::memory_order_relaxed);
+        }
+    }
+    m_generation = 0;
+    m_probes = 0;
+    m_hits = 0;
+}
+
+size_t TranspositionTable::sizeMb() const {
+    return m_bucketCount * sizeof(Bucket) / (1024 * 1024);
+}
+
+void TranspositionTable::newSearch() {
+    m_generation = (m_generation + 1) & 63;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTData& out) const {
+    for (const Entry& entry : bucketFor(key).entries) {
+        uint64_t data = entry.data.load(std::memory_order_relaxed);
+        uint64_t check = entry.keyXorData.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && boundOf(data) != Bound::NONE) {
+            out.move.data = static_cast<uint16_t>(data);
+            out.score = static_cast<int16_t>(data >> 16);
+            out.depth = depthOf(data);
+            out.bound = boundOf(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TranspositionTable::store(uint64_t key, EngineMove move, int score, int depth, Bound bound) {
+    Bucket& bucket = bucketFor(key);
+
+    // reuse the slot already holding this key or an empty one, otherwise evict the shallowest
+    // entry with every search of age costing it 8 plies
+    Entry* replace = &bucket.entries[0];
+    uint64_t replaceData = 0;
+    bool sameKey = false;
+    int worst = INT_MAX;
+    for (Entry& entry : bucket.entries) {
+        uint64_t data = entry.data.load(std::memory_order_relaxed);
+        uint64_t entryKey = entry.keyXorData.load(std::memory_order_relaxed) ^ data;
+        if (entryKey == key || boundOf(data) == Bound::NONE) {
+            replace = &entry;
+            replaceData = data;
+            sameKey = entryKey == key;
+            break;
+        }
+        int age = (m_generation - generationOf(data)) & 63;
+        int value = depthOf(data) - 8 * age;
+        if (value < worst) {
+            worst = value;
+            replace = &entry;
+            replaceData = data;
+        }
+    }
+
+    if (sameKey) {
+        // keep deeper results from this search unless the new one is exact
+        if (bound != Bound::EXACT && depth < depthOf(replaceData) - 2 && generationOf(replaceData) == m_generation) {
+            return;
+        }
+        if (move.isNull()) {
+            move.data = static_cast<uint16_t>(replaceData);
+        }
+    }
+
+    uint64_t data = packData(move, score, depth, bound, m_generation);
+    replace->keyXorData.store(key ^ data, std::memory_order_relaxed);
+    replace->data.store(data, std::memory_order_relaxed);
+}
+
+void TranspositionTable::addProbeStats(uint64_t probes, uint64_t hits) {
+    m_probes.fetch_add(probes, std::memory_order_relaxed);
+    m_hits.fetch_add(hits, std::memory_order_relaxed);
+}
+
+TTStats TranspositionTable::stats() const {
+    TTStats stats;
+    stats.probes = m_probes.load(std::memory_order_relaxed);
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    stats.hitRate = stats.probes ? static_cast<double>(stats.hits) / stats.probes : 0.0;
+
+    // occupancy is sampled from the first buckets rather than counted over the whole table
+    size_t sample = std::min<size_t>(m_bucketCount, 1000);
+    int used = 0, current = 0;
+    for (size_t i = 0; i < sample; i++) {
+        for (const Entry& entry : m_buckets[i].entries) {
+            uint64_t data = entry.data.load(std::memory_order_relaxed);
+            if (boundOf(data) != Bound::NONE) {
+                used++;
+                if (generationOf(data) == m_generation) {
+                    current++;
+                }
+            }
+        }
+    }
+    stats.totalOccupancy = static_cast<int>(used * 1000 / (sample * 4));
+    stats.occupancy = static_cast<int>(current * 1000 / (sample * 4));
+    return stats;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "BoardState.h"
+
+// Transposition table shared between search threads without locks. Every entry is two 64 bit
+// words written independently; the first holds key ^ data, so a torn write from two threads
+// racing on the same slot fails the key check on probe instead of returning mixed data.
+
+enum class Bound : uint8_t { NONE, UPPER, LOWER, EXACT };
+
+struct TTData {
+	EngineMove move;
+	int score;
+	int depth;
+	Bound bound;
+};
+
+struct TTStats {
+	uint64_t probes;
+	uint64_t hits;
+	double hitRate;
+	int occupancy;      // permille of sampled entries written during the current search
+	int totalOccupancy; // permille of sampled entries written at all
+};
+
+class TranspositionTable {
+public:
+	explicit TranspositionTable(size_t sizeMb = 16);
+
+	// resizing and clearing are not thread safe, only call them between searches
+	void resize(size_t sizeMb);
+	void clear();
+	size_t sizeMb() const;
+
+	// ages every stored entry by one search
+	void newSearch();
+
+	bool probe(uint64_t key, TTData& out) const;
+	void store(uint64_t key, EngineMove move, int score, int depth, Bound bound);
+
+	// searchers count probes locally and add them once per search to keep the counters off the hot path
+	void addProbeStats(uint64_t probes, uint64_t hits);
+	TTStats stats() const;
+
+private:
+	struct Entry {
+		std::atomic<uint64_t> keyXorData;
+		std::atomic<uint64_t> data;
+	};
+
+	// four entries fill one cache line, so a probe touches a single line
+	struct alignas(64) Bucket {
+		Entry entries[4];
+	};
+
+	Bucket& bucketFor(uint64_t key) const { return m_buckets[key & (m_bucketCount - 1)]; }
+
+	std::unique_ptr<Bucket[]> m_buckets;
+	size_t m_bucketCount;
+	uint8_t m_generation;
+	std::atomic<uint64_t> m_probes;
+	std::atomic<uint64_t> m_hits;
+};
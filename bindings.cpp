@@ -1,71 +1,203 @@
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
 #include <vector>
+#include "BoardState.h"
 #include "ChessObjects.h"
+#include "Search.h"
 
-
+// Python module over the engine. The batch calls take many positions or games per call so the
+// per-call overhead is paid once, drop the GIL while they run, and hand back NumPy arrays that
+// own the C++ buffers they were built in rather than copies of them. Moves are EngineMove's
+// 16-bit encoding: from square in bits 0-5, to square in bits 6-11, move type above; squares are
+// row * 8 + col with row 0 the eighth rank.
 
 namespace py = pybind11;
 
-void playGame(Game& game) {
-    game.playGame();
+// a NumPy array taking over the vector's buffer, freed when the array is collected
+template <typename T>
+static py::array_t<T> toArray(std::vector<T>&& values, std::vector<py::ssize_t> shape) {
+    auto* owned = new std::vector<T>(std::move(values));
+    py::capsule release(owned, [](void* pointer) { delete static_cast<std::vector<T>*>(pointer); });
+    return py::array_t<T>(shape, owned->data(), release);
+}
+
+template <typename T>
+static py::array_t<T> toArray(std::vector<T>&& values) {
+    py::ssize_t size = static_cast<py::ssize_t>(values.size());
+    return toArray(std::move(values), { size });
+}
+
+static std::vector<BoardState> parseFens(const std::vector<std::string>& fens) {
+    std::vector<BoardState> positions(fens.size());
+    for (size_t i = 0; i < fens.size(); i++) {
+        if (!BoardState::fromFen(fens[i], positions[i])) {
+            throw std::invalid_argument("bad FEN: " + fens[i]);
+        }
+    }
+    return positions;
+}
+
+// every position's legal moves back to back; position i's are moves[offsets[i]:offsets[i + 1]]
+static py::tuple legalMoves(const std::vector<std::string>& fens) {
+    std::vector<BoardState> positions = parseFens(fens);
+    std::vector<uint16_t> moves;
+    std::vector<int64_t> offsets(positions.size() + 1, 0);
+    {
+        py::gil_scoped_release release;
+        moves.reserve(positions.size() * 40);
+        MoveList list;
+        for (size_t i = 0; i < positions.size(); i++) {
+            list.size = 0;
+            generateLegalMoves(positions[i], list);
+            for (EngineMove move : list) {
+                moves.push_back(move.data);
+            }
+            offsets[i + 1] = static_cast<int64_t>(moves.size());
+        }
+    }
+    return py::make_tuple(toArray(std::move(moves)), toArray(std::move(offsets)));
+}
+
+// destination bitboards per origin square, uint64[N, 64]; bit t of [i, f] is the move f -> t.
+// np.unpackbits(masks.view(np.uint8), bitorder="little").reshape(N, 64, 64) gives from x to planes
+static py::array_t<uint64_t> legalMasks(const std::vector<std::string>& fens) {
+    std::vector<BoardState> positions = parseFens(fens);
+    std::vector<uint64_t> masks(positions.size() * 64);
+    {
+        py::gil_scoped_release release;
+        LegalMask mask;
+        for (size_t i = 0; i < positions.size(); i++) {
+            generateLegalMask(positions[i], mask);
+            std::copy(std::begin(mask.destinations), std::end(mask.destinations), masks.begin() + i * 64);
+        }
+    }
+    return toArray(std::move(masks), { static_cast<py::ssize_t>(positions.size()), 64 });
+}
+
+static py::array_t<uint64_t> perftBatch(const std::vector<std::string>& fens, int depth) {
+    std::vector<BoardState> positions = parseFens(fens);
+    std::vector<uint64_t> nodes(positions.size());
+    {
+        py::gil_scoped_release release;
+        for (size_t i = 0; i < positions.size(); i++) {
+            nodes[i] = perft(positions[i], depth);
+        }
+    }
+    return toArray(std::move(nodes));
+}
+
+// Uniformly random legal moves until mate, stalemate, the fifty-move rule, insufficient material
+// or maxPlies. Game g is seeded with seed + g, so any one game can be replayed on its own. Results
+// are 1 for a white win, -1 for a black win and 0 for a draw or an unfinished game.
+static py::tuple playRandomGames(int count, int maxPlies, uint64_t seed) {
+    std::vector<uint16_t> moves;
+    std::vector<int64_t> offsets(static_cast<size_t>(count) + 1, 0);
+    std::vector<int8_t> results(static_cast<size_t>(count), 0);
+    {
+        py::gil_scoped_release release;
+        MoveList list;
+        for (int g = 0; g < count; g++) {
+            std::mt19937_64 rng(seed + static_cast<uint64_t>(g));
+            BoardState board = BoardState::startPosition();
+            int halfmoveClock = 0;
+            for (int ply = 0; ply < maxPlies && halfmoveClock < 100 && !board.insufficientMaterial(); ply++) {
+                list.size = 0;
+                generateLegalMoves(board, list);
+                if (list.size == 0) {
+                    if (board.inCheck()) {
+                        results[g] = board.turn == Piece::Color::WHITE ? -1 : 1;
+                    }
+                    break;
+                }
+                EngineMove move = list.moves[rng() % static_cast<uint64_t>(list.size)];
+                bool irreversible = board.squares[move.to()] != NO_PIECE || typeOf(board.squares[move.from()]) == Piece::PieceType::PAWN;
+                halfmoveClock = irreversible ? 0 : halfmoveClock + 1;
+                UndoInfo undo;
+                board.makeMove(move, undo);
+                moves.push_back(move.data);
+            }
+            offsets[g + 1] = static_cast<int64_t>(moves.size());
+        }
+    }
+    return py::make_tuple(toArray(std::move(moves)), toArray(std::move(offsets)), toArray(std::move(results)));
+}
+
+static py::tuple search(const std::string& fen, int depth, int64_t moveTimeMs) {
+    BoardState position;
+    if (!BoardState::fromFen(fen, position)) {
+        throw std::invalid_argument("bad FEN: " + fen);
+    }
+    SearchLimits limits;
+    limits.maxDepth = std::clamp(depth, 1, MAX_PLY - 1);
+    limits.moveTimeMs = moveTimeMs;
+    SearchResult result;
+    {
+        py::gil_scoped_release release;
+        Searcher searcher;
+        result = searcher.search(position, limits);
+    }
+    return py::make_tuple(result.bestMove.isNull() ? std::string() : result.bestMove.toUci(), result.score, result.depth, result.nodes);
+}
+
+static std::vector<std::string> movesToUci(py::array_t<uint16_t, py::array::c_style | py::array::forcecast> moves) {
+    std::vector<std::string> uci;
+    uci.reserve(static_cast<size_t>(moves.size()));
+    const uint16_t* data = moves.data();
+    for (py::ssize_t i = 0; i < moves.size(); i++) {
+        EngineMove move;
+        move.data = data[i];
+        uci.push_back(move.toUci());
+    }
+    return uci;
 }
 
 PYBIND11_MODULE(chess, m) {
-    py::class_<Game>(m, "Game")
-        .def(py::init<>())  // Default constructor for Game
-        .def("play_game", &playGame);
+    m.doc() = "Chess engine bindings: batch move generation, perft, random games and search";
 
-    py::class_<Player>(m, "Player")
-        .def("get_color", &Player::getColor);
+    py::enum_<Piece::Color>(m, "Color")
+        .value("WHITE", Piece::Color::WHITE)
+        .value("BLACK", Piece::Color::BLACK);
 
-    py::class_<Piece>(m, "Piece")
-        .def("get_color", &Piece::getColor);
+    py::class_<Position>(m, "Position")
+        .def(py::init<int, int>(), py::arg("row"), py::arg("col"))
+        .def_readwrite("row", &Position::row)
+        .def_readwrite("col", &Position::col);
 
     py::class_<Move>(m, "Move")
-        .def(py::init<const Position&, const Position&>())
-        .def("get_from", &Move::getFrom)
-        .def("get_to", &Move::getTo);
-}
+        .def(py::init<Position, Position>(), py::arg("from_pos"), py::arg("to_pos"))
+        .def_readonly("from_pos", &Move::m_from)
+        .def_readonly("to_pos", &Move::m_to);
+
+    py::class_<Player>(m, "Player")
+        .def(py::init<>())
+        .def("get_color", &Player::getColor)
+        .def("is_bot", &Player::isBot)
+        .def("set_bot", &Player::setBot, py::arg("max_depth"), py::arg("move_time_ms"));
 
-//
-//
-//cmake_minimum_required(VERSION 3.12)
-//project(chess_game)
-//
-//set(CMAKE_CXX_STANDARD 14)
-//
-//# Path to pybind11(either from system package or from source)
-//find_package(pybind11 REQUIRED)
-//
-//# Add your source files here
-//add_library(chess MODULE bindings.cpp game.cpp)
-//
-//target_link_libraries(chess PRIVATE pybind11::module)
-//
-//
-//mkdir build
-//cd build
-//cmake ..
-//make
-
-//import chess
-//
-//# Create a Game object
-//game = chess.Game()
-//
-//# Play the game using C++ logic
-//game.play_game()
-
-//from flask import Flask, jsonify
-//import chess
-//
-//app = Flask(__name__)
-//
-//@app.route('/start_game', methods = ['GET'])
-//def start_game() :
-//    game = chess.Game()
-//    game.play_game()  # Call the C++ game logic
-//    return jsonify({ "status": "Game Over" })
-//
-//    if __name__ == '__main__':
-//app.run(debug = True)
\ No newline at end of file
+    // the game keeps copies of its players, picking their colours itself
+    py::class_<Game>(m, "Game")
+        .def(py::init([]() {
+            Player white, black;
+            return std::make_unique<Game>(white, black);
+        }))
+        .def(py::init([](Player& first, Player& second) { return std::make_unique<Game>(first, second); }))
+        .def("play_game", &Game::playGame, py::call_guard<py::gil_scoped_release>(), "interactive game on stdin and stdout")
+        .def("get_evaluation", &Game::getEvaluation)
+        .def("get_halfmove_clock", &Game::getHalfmoveClock);
+
+    m.def("legal_moves", &legalMoves, py::arg("fens"),
+        "legal moves of every position as (moves uint16[M], offsets int64[N + 1])");
+    m.def("legal_masks", &legalMasks, py::arg("fens"), "legal moves of every position as destination masks, uint64[N, 64]");
+    m.def("perft", [](const std::string& fen, int depth) { return perftBatch({ fen }, depth).at(0); }, py::arg("fen"), py::arg("depth"));
+    m.def("perft_batch", &perftBatch, py::arg("fens"), py::arg("depth"), "leaf counts as uint64[N]");
+    m.def("play_random_games", &playRandomGames, py::arg("count"), py::arg("max_plies") = 400, py::arg("seed") = 0,
+        "random games from the start as (moves uint16[M], offsets int64[count + 1], results int8[count])");
+    m.def("search", &search, py::arg("fen"), py::arg("depth") = 8, py::arg("move_time_ms") = 0,
+        "best move as (uci, score in centipawns for the side to move, depth, nodes)");
+    m.def("moves_to_uci", &movesToUci, py::arg("moves"));
+}